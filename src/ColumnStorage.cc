@@ -0,0 +1,153 @@
+#include "ColumnStorage.h"
+
+#include <filesystem>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace carta {
+
+using namespace std;
+
+// Allocations are whole pages, as mapped regions of the file must start on page boundaries
+static size_t PageAligned(size_t size) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    return max((size + page_size - 1) / page_size * page_size, page_size);
+}
+
+static size_t SlabAligned(size_t size) {
+    return max((size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT, ARENA_ALIGNMENT);
+}
+
+// Maps anonymous memory of a page-aligned size starting on a huge page boundary, or returns nullptr. The mapping is
+// over-allocated by one huge page and trimmed to the aligned region
+static void* MapHugePageAligned(size_t size) {
+    size_t mapped_size = size + HUGE_PAGE_SIZE;
+    void* mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    auto start = static_cast<uint8_t*>(mapping);
+    auto aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(start) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > start) {
+        munmap(start, aligned - start);
+    }
+    size_t tail_size = start + mapped_size - (aligned + size);
+    if (tail_size) {
+        munmap(aligned + size, tail_size);
+    }
+    // Transparent huge pages are only a hint, and the mapping works with regular pages if they are unavailable
+    madvise(aligned, size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+shared_ptr<ColumnStorage> ColumnStorage::FromArena() {
+    return shared_ptr<ColumnStorage>(new ColumnStorage(-1));
+}
+
+shared_ptr<ColumnStorage> ColumnStorage::FromScratchDirectory(const string& directory) {
+    auto path = (filesystem::path(directory) / SCRATCH_FILE_TEMPLATE).string();
+    int file_descriptor = mkstemp(path.data());
+    if (file_descriptor < 0) {
+        return nullptr;
+    }
+    // The file remains usable until it is closed, and cannot be left behind if the process exits
+    unlink(path.c_str());
+    return shared_ptr<ColumnStorage>(new ColumnStorage(file_descriptor));
+}
+
+ColumnStorage::ColumnStorage(int file_descriptor)
+    : _file_descriptor(file_descriptor), _file_size(0), _allocated_size(0), _slab_position(nullptr), _slab_remaining(0) {}
+
+// Every allocation holds a reference to its storage, so the only remaining mappings are slabs
+ColumnStorage::~ColumnStorage() {
+    for (auto slab: _slabs) {
+        munmap(slab, ARENA_SLAB_SIZE);
+    }
+    if (_file_descriptor >= 0) {
+        close(_file_descriptor);
+    }
+}
+
+void* ColumnStorage::Allocate(size_t size) {
+    lock_guard<mutex> guard(_mutex);
+    if (_file_descriptor < 0) {
+        if (size <= ARENA_MAX_SLAB_ALLOCATION) {
+            return AllocateFromSlab(size);
+        }
+        size = PageAligned(size);
+        void* ptr = MapHugePageAligned(size);
+        if (!ptr) {
+            throw bad_alloc();
+        }
+        _allocated_size += size;
+        _mappings[ptr] = size;
+        return ptr;
+    }
+
+    size = PageAligned(size);
+    size_t offset = _file_size;
+    if (ftruncate(_file_descriptor, offset + size)) {
+        throw bad_alloc();
+    }
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _file_descriptor, offset);
+    if (ptr == MAP_FAILED) {
+        throw bad_alloc();
+    }
+    _file_size += size;
+    _allocated_size += size;
+    _mappings[ptr] = offset;
+    return ptr;
+}
+
+void ColumnStorage::Deallocate(void* ptr, size_t size) {
+    lock_guard<mutex> guard(_mutex);
+    if (_file_descriptor < 0 && size <= ARENA_MAX_SLAB_ALLOCATION) {
+        // Only the most recent allocation of the current slab is reused, which covers a vector growing at the end of a slab
+        size_t aligned_size = SlabAligned(size);
+        if (static_cast<uint8_t*>(ptr) + aligned_size == _slab_position && _slab_remaining + aligned_size <= ARENA_SLAB_SIZE) {
+            _slab_position -= aligned_size;
+            _slab_remaining += aligned_size;
+        }
+        return;
+    }
+
+    size = PageAligned(size);
+    auto it = _mappings.find(ptr);
+    if (it == _mappings.end()) {
+        return;
+    }
+    munmap(ptr, size);
+    if (_file_descriptor >= 0) {
+        // Dirty pages of the freed region are discarded rather than written back
+        fallocate(_file_descriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, it->second, size);
+    }
+    _allocated_size -= size;
+    _mappings.erase(it);
+}
+
+size_t ColumnStorage::AllocatedSize() const {
+    lock_guard<mutex> guard(_mutex);
+    return _allocated_size;
+}
+
+void* ColumnStorage::AllocateFromSlab(size_t size) {
+    size = SlabAligned(size);
+    if (size > _slab_remaining) {
+        void* slab = MapHugePageAligned(ARENA_SLAB_SIZE);
+        if (!slab) {
+            throw bad_alloc();
+        }
+        _slabs.push_back(slab);
+        _allocated_size += ARENA_SLAB_SIZE;
+        _slab_position = static_cast<uint8_t*>(slab);
+        _slab_remaining = ARENA_SLAB_SIZE;
+    }
+    void* ptr = _slab_position;
+    _slab_position += size;
+    _slab_remaining -= size;
+    return ptr;
+}
+
+}
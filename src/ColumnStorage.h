@@ -0,0 +1,128 @@
+#ifndef VOTABLE_TEST__COLUMNSTORAGE_H_
+#define VOTABLE_TEST__COLUMNSTORAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Name of the scratch file holding out-of-core column entries, which is removed from its directory as soon as it is created
+#define SCRATCH_FILE_TEMPLATE "carta-columns-XXXXXX"
+// Size and alignment of the huge pages backing in-memory column storage
+#define HUGE_PAGE_SIZE (size_t(2) << 20)
+// Size of the slabs that small allocations of in-memory column storage are carved from
+#define ARENA_SLAB_SIZE HUGE_PAGE_SIZE
+// In-memory allocations larger than this are mapped individually rather than carved from a slab
+#define ARENA_MAX_SLAB_ALLOCATION (ARENA_SLAB_SIZE / 4)
+// Alignment of allocations carved from a slab
+#define ARENA_ALIGNMENT size_t(64)
+
+namespace carta {
+
+// Memory for the entries of a table's columns, shared by all of its columns.
+//
+// In-memory storage is an arena of huge-page-aligned anonymous mappings. Small allocations are carved from slabs and are
+// only returned when the storage is destroyed, while large allocations are mapped individually and unmapped when freed.
+// A table's columns therefore need one allocation from the system per slab or large column rather than one per column,
+// and releasing them takes one unmap each.
+//
+// Out-of-core storage is a scratch file mapped into memory. The operating system writes pages of entries that have not
+// been used recently back to the file and drops them from memory, so the page cache acts as the resident set and a
+// table's columns can be larger than physical memory. The space of freed entries is released from the file, and the file
+// itself is deleted when the storage is destroyed
+class ColumnStorage {
+public:
+    // In-memory storage
+    static std::shared_ptr<ColumnStorage> FromArena();
+    // Out-of-core storage in a new scratch file in the given directory, or nullptr if the file cannot be created
+    static std::shared_ptr<ColumnStorage> FromScratchDirectory(const std::string& directory);
+    ~ColumnStorage();
+    // Throws std::bad_alloc if the memory cannot be mapped or the scratch file cannot be extended
+    void* Allocate(size_t size);
+    void Deallocate(void* ptr, size_t size);
+    // Bytes of memory currently mapped by the storage
+    size_t AllocatedSize() const;
+
+protected:
+    ColumnStorage(int file_descriptor);
+
+    void* AllocateFromSlab(size_t size);
+
+    // Descriptor of the scratch file, or -1 for in-memory storage
+    int _file_descriptor;
+    size_t _file_size;
+    size_t _allocated_size;
+    // File offset of each out-of-core allocation, or size of each large in-memory allocation. File offsets are not
+    // reused, as the space of freed allocations is released from the file
+    std::unordered_map<void*, size_t> _mappings;
+    std::vector<void*> _slabs;
+    // Unused part of the most recent slab
+    uint8_t* _slab_position;
+    size_t _slab_remaining;
+    mutable std::mutex _mutex;
+};
+
+// Allocator for column entries, which uses column storage if given and the heap otherwise. The allocator moves with the
+// entries on assignment, so that entries always return their memory to the storage they were allocated from. Entries added
+// by resizing are default-initialized, leaving arithmetic entries uninitialized until they are filled, so that their pages
+// are first touched by the threads filling them rather than by the thread resizing the column
+template<class T>
+class ColumnAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ColumnAllocator() = default;
+    explicit ColumnAllocator(std::shared_ptr<ColumnStorage> column_storage) : storage(std::move(column_storage)) {}
+    template<class U>
+    ColumnAllocator(const ColumnAllocator<U>& other) : storage(other.storage) {}
+
+    T* allocate(size_t n) {
+        if (storage) {
+            return static_cast<T*>(storage->Allocate(n * sizeof(T)));
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    template<class U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template<class U, class... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        if (storage) {
+            storage->Deallocate(ptr, n * sizeof(T));
+        } else {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    std::shared_ptr<ColumnStorage> storage;
+};
+
+template<class T, class U>
+bool operator==(const ColumnAllocator<T>& a, const ColumnAllocator<U>& b) {
+    return a.storage == b.storage;
+}
+
+template<class T, class U>
+bool operator!=(const ColumnAllocator<T>& a, const ColumnAllocator<U>& b) {
+    return a.storage != b.storage;
+}
+
+template<class T>
+using ColumnEntries = std::vector<T, ColumnAllocator<T>>;
+
+}
+
+#endif //VOTABLE_TEST__COLUMNSTORAGE_H_
@@ -49,6 +49,23 @@ std::unique_ptr<Column> Column::FromField(const pugi::xml_node& field) {
     return column;
 }
 
+std::unique_ptr<Column> Column::FromDataType(DataType data_type, const string& name) {
+    switch (data_type) {
+        case STRING: return make_unique<DataColumn<string>>(name);
+        case UINT8: return make_unique<DataColumn<uint8_t>>(name);
+        case INT8: return make_unique<DataColumn<int8_t>>(name);
+        case UINT16: return make_unique<DataColumn<uint16_t>>(name);
+        case INT16: return make_unique<DataColumn<int16_t>>(name);
+        case UINT32: return make_unique<DataColumn<uint32_t>>(name);
+        case INT32: return make_unique<DataColumn<int32_t>>(name);
+        case UINT64: return make_unique<DataColumn<uint64_t>>(name);
+        case INT64: return make_unique<DataColumn<int64_t>>(name);
+        case FLOAT: return make_unique<DataColumn<float>>(name);
+        case DOUBLE: return make_unique<DataColumn<double>>(name);
+        default: return make_unique<Column>(name);
+    }
+}
+
 void TrimSpaces(string& str) {
     str.erase(str.find_last_not_of(' ') + 1);
 }
@@ -139,16 +156,16 @@ string Column::Info() {
 
 // Specialisation for string type, in order to trim whitespace at the end of the entry
 template<>
-void DataColumn<string>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) {
+void DataColumn<string>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride, size_t first_row) {
     // Shifts by the column's offset
     ptr += data_offset;
 
-    if (!stride || !data_type_size || num_rows > entries.size()) {
+    if (!stride || !data_type_size || first_row + num_rows > entries.size()) {
         return;
     }
 
     for (auto i = 0; i < num_rows; i++) {
-        auto& s = entries[i];
+        auto& s = entries[first_row + i];
 
         int string_size = 0;
         // Find required string size by trimming whitespace
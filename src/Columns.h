@@ -9,6 +9,14 @@
 #include <pugixml.hpp>
 #include <fitsio.h>
 #include <fmt/format.h>
+#include "ColumnStorage.h"
+#include "PackedEntries.tcc"
+#include "QuantileSketch.h"
+
+// Number of rows summarised by each entry of a column's block statistics
+#define STATISTICS_BLOCK_SIZE (64 * 1024)
+// Number of leading characters of a string stored in its normalized sort key
+#define NORMALIZED_STRING_PREFIX_SIZE 16
 
 namespace carta {
 
@@ -43,22 +51,81 @@ enum ComparisonOperator {
     RANGE_EXCLUSIVE = 7
 };
 
+// Min/max summary of a contiguous block of rows. NaN entries are excluded from min and max and counted separately
+template<class T>
+struct BlockStatistics {
+    T min;
+    T max;
+    int64_t nan_count;
+};
+
+// Summary statistics of a column's entries. NaN entries are excluded from all statistics other than nan_count.
+// The variance is the population variance of the entries
+struct ColumnStatistics {
+    int64_t count = 0;
+    int64_t nan_count = 0;
+    double sum = 0;
+    double mean = NAN;
+    double min = NAN;
+    double max = NAN;
+    double variance = NAN;
+    double std_dev = NAN;
+};
+
+// Counts of entries in equal-width bins spanning [min, max]. Log-scale bins have equal widths in log10 of the entries.
+// NaNs and entries outside the range are not counted
+struct ColumnHistogram {
+    double min = NAN;
+    double max = NAN;
+    bool log_scale = false;
+    std::vector<int64_t> counts;
+};
+
 class Column {
 public:
     Column(const std::string& name_chr);
     virtual ~Column() = default;
     virtual void SetFromText(const pugi::xml_text& text, size_t index) {};
     virtual void SetEmpty(size_t index) {};
-    virtual void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) {};
+    // Fills entries [first_row, first_row + num_rows) from rows of binary table data, stride bytes apart
+    virtual void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride, size_t first_row = 0) {};
+    // Entries allocated by later calls to Resize use the given storage, or the heap if it is null
+    virtual void SetStorage(const std::shared_ptr<ColumnStorage>& storage) {};
+    // Added numeric entries are left uninitialized, and must be filled before they are read
     virtual void Resize(size_t capacity) {};
     virtual size_t NumEntries() const { return 0; }
+    virtual void ComputeBlockStatistics() {};
     virtual void SortIndices(IndexList& indices, bool ascending) const {};
+    virtual void PartialSortIndices(IndexList& indices, size_t begin, size_t end, bool ascending) const {};
+    virtual void TopIndices(IndexList& indices, bool is_subset, size_t num_top, bool ascending) const {};
+    virtual size_t NumValidSorted(const IndexList& sorted_indices) const { return sorted_indices.size(); }
     virtual void FilterIndices(IndexList& existing_indices, bool is_subset, ComparisonOperator comparison_operator, double value, double secondary_value = 0.0) const {}
+    virtual bool SortedRange(const IndexList& sorted_indices, ComparisonOperator comparison_operator, double value, double secondary_value, size_t& begin, size_t& end) const { return false; }
+    virtual size_t NormalizedKeySize() const { return 0; }
+    virtual bool NormalizedKeyTruncated(const uint8_t* key) const { return false; }
+    virtual void FillNormalizedKeys(const IndexList& indices, uint8_t* keys, size_t key_stride, bool ascending) const {}
+    virtual int CompareEntries(int64_t a, int64_t b) const { return 0; }
+    virtual bool Aggregate(const IndexList& indices, bool is_subset, ColumnStatistics& stats) const { return false; }
+    virtual bool FillHistogram(const IndexList& indices, bool is_subset, int num_bins, bool log_scale, double min_val, double max_val, ColumnHistogram& histogram) const { return false; }
+    virtual bool FillQuantileSketch(const IndexList& indices, bool is_subset, QuantileSketch& sketch) const { return false; }
+    virtual bool ExactQuantiles(const IndexList& indices, bool is_subset, bool sorted, const std::vector<double>& fractions, std::vector<double>& quantiles) const { return false; }
+    virtual size_t BatchEntrySize(const IndexList& indices, bool is_subset, int64_t start, int64_t end) const { return 0; }
+    virtual void FillBatchEntries(const IndexList& indices, bool is_subset, int64_t start, int64_t end, uint8_t* output, size_t stride, size_t entry_size) const {}
+    virtual bool GroupIndices(const IndexList& indices, bool is_subset, IndexList& group_ids, IndexList& group_rows, IndexList& group_sizes) const { return false; }
+    virtual bool AggregateGroups(const IndexList& indices, bool is_subset, const IndexList& group_ids, size_t num_groups, std::vector<ColumnStatistics>& stats) const { return false; }
+    virtual size_t MemorySize() const { return 0; }
+    virtual bool Compress() { return false; }
+    virtual bool IsCompressed() const { return false; }
+    virtual size_t CacheDataSize() const { return 0; }
+    virtual void FillCacheData(uint8_t* output) const {}
+    virtual bool LoadCacheData(const uint8_t* data, size_t size, size_t num_rows) { return size == 0; }
     virtual std::string Info();
 
     // Factory for constructing a column from a <FIELD> node
     static std::unique_ptr<Column> FromField(const pugi::xml_node& field);
     static std::unique_ptr<Column> FromFitsPtr(fitsfile* fits_ptr, int column_index, size_t& data_offset);
+    // Factory for constructing an empty column of the given type, as stored in a table cache
+    static std::unique_ptr<Column> FromDataType(DataType data_type, const std::string& name);
 
     DataType data_type;
     std::string name;
@@ -75,16 +142,101 @@ public:
 template<class T>
 class DataColumn : public Column {
 public:
-    std::vector<T> entries;
+    // Empty while the column is compressed
+    ColumnEntries<T> entries;
+    // Per-block statistics, computed after loading and used to skip or accept entire blocks when filtering
+    std::vector<BlockStatistics<T>> block_statistics;
     DataColumn(const std::string& name_chr);
     virtual ~DataColumn() = default;
     void SetFromText(const pugi::xml_text& text, size_t index) override;
     void SetEmpty(size_t index) override;
-    void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) override;
+    void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride, size_t first_row = 0) override;
+    void SetStorage(const std::shared_ptr<ColumnStorage>& storage) override;
     void Resize(size_t capacity) override;
     size_t NumEntries() const override;
+    void ComputeBlockStatistics() override;
     void SortIndices(IndexList& indices, bool ascending) const override;
+    // Sorts only the indices that belong in positions [begin, end) of the sorted list
+    void PartialSortIndices(IndexList& indices, size_t begin, size_t end, bool ascending) const override;
+    // Replaces the indices with the first num_top indices of the sorted list, in sorted order
+    void TopIndices(IndexList& indices, bool is_subset, size_t num_top, bool ascending) const override;
+    // Number of leading entries in an index list sorted by this column that are not NaN
+    size_t NumValidSorted(const IndexList& sorted_indices) const override;
     void FilterIndices(IndexList& existing_indices, bool is_subset, ComparisonOperator comparison_operator, double value, double secondary_value = 0.0) const override;
+    // Finds the range [begin, end) of an ascending sorted index list that passes the given comparison
+    bool SortedRange(const IndexList& sorted_indices, ComparisonOperator comparison_operator, double value, double secondary_value, size_t& begin, size_t& end) const override;
+    // Normalized keys are fixed-size byte strings that compare with memcmp in the same order as the entries they encode.
+    // String keys hold a prefix of the string, so keys that are equal but truncated must be compared using CompareEntries
+    size_t NormalizedKeySize() const override;
+    bool NormalizedKeyTruncated(const uint8_t* key) const override;
+    void FillNormalizedKeys(const IndexList& indices, uint8_t* keys, size_t key_stride, bool ascending) const override;
+    int CompareEntries(int64_t a, int64_t b) const override;
+    // Computes statistics over the given indices, or the entire column if is_subset is false
+    bool Aggregate(const IndexList& indices, bool is_subset, ColumnStatistics& stats) const override;
+    // Bins the given indices, or the entire column if is_subset is false. A NaN range limit is replaced by the minimum or
+    // maximum of the entries, excluding non-positive entries for log-scale histograms
+    bool FillHistogram(const IndexList& indices, bool is_subset, int num_bins, bool log_scale, double min_val, double max_val, ColumnHistogram& histogram) const override;
+    // Adds the entries at the given indices, or the entire column if is_subset is false, to the sketch. NaNs are skipped
+    bool FillQuantileSketch(const IndexList& indices, bool is_subset, QuantileSketch& sketch) const override;
+    // Quantiles of the entries, interpolated linearly between the closest entries. If sorted is true, the indices must
+    // be sorted in ascending order of the entries, with NaNs last
+    bool ExactQuantiles(const IndexList& indices, bool is_subset, bool sorted, const std::vector<double>& fractions, std::vector<double>& quantiles) const override;
+    // Width in bytes of packed entries for positions [start, end) of the given indices, or rows [start, end) if is_subset
+    // is false. Strings are packed with the width of the longest string
+    size_t BatchEntrySize(const IndexList& indices, bool is_subset, int64_t start, int64_t end) const override;
+    // Packs the entries for positions [start, end) into fields of entry_size bytes, stride bytes apart. Strings are padded with nulls
+    void FillBatchEntries(const IndexList& indices, bool is_subset, int64_t start, int64_t end, uint8_t* output, size_t stride, size_t entry_size) const override;
+    // Assigns each of the given indices, or each entry if is_subset is false, the ID of its group of equal entries (-1 for
+    // invalid indices). Groups are numbered in ascending order of their entries, with NaNs last. group_rows holds the first
+    // row of each group, and group_sizes the number of rows in each group
+    bool GroupIndices(const IndexList& indices, bool is_subset, IndexList& group_ids, IndexList& group_rows, IndexList& group_sizes) const override;
+    // Computes statistics for each group, with group_ids aligned with the given indices as returned by GroupIndices
+    bool AggregateGroups(const IndexList& indices, bool is_subset, const IndexList& group_ids, size_t num_groups, std::vector<ColumnStatistics>& stats) const override;
+    // Approximate heap memory used by the entries and block statistics, in bytes
+    size_t MemorySize() const override;
+    // Replaces the entries of an integer column with packed entries if that saves memory, returning whether the column is
+    // compressed. Block statistics must be computed first. Filters work directly on the packed entries, while other
+    // operations decode the entries they need
+    bool Compress() override;
+    bool IsCompressed() const override {
+        return !_packed_entries.Empty();
+    }
+    // Entry at the given row, decoded if the column is compressed
+    T Entry(int64_t row) const {
+        if constexpr (PackedEntries<T>::packable) {
+            if (IsCompressed()) {
+                return _packed_entries.Get(row);
+            }
+        }
+        return entries[row];
+    }
+    // Copies the entries at the given rows, or of rows [start, end), decoding them if the column is compressed
+    void GatherEntries(const int64_t* rows, int64_t num_rows, T* output) const {
+        if constexpr (PackedEntries<T>::packable) {
+            if (IsCompressed()) {
+                _packed_entries.Gather(rows, num_rows, output);
+                return;
+            }
+        }
+        for (int64_t i = 0; i < num_rows; i++) {
+            output[i] = entries[rows[i]];
+        }
+    }
+    void CopyEntries(int64_t start, int64_t end, T* output) const {
+        if constexpr (PackedEntries<T>::packable) {
+            if (IsCompressed()) {
+                _packed_entries.Unpack(start, end, output);
+                return;
+            }
+        }
+        std::copy(entries.begin() + start, entries.begin() + end, output);
+    }
+    // Raw entries as stored in a table cache. Numeric entries are stored in native byte order, and strings as num_rows + 1
+    // uint64 offsets into the characters that follow them
+    size_t CacheDataSize() const override;
+    void FillCacheData(uint8_t* output) const override;
+    // Replaces the entries with num_rows entries read from cache data, returning false if the size does not match
+    bool LoadCacheData(const uint8_t* data, size_t size, size_t num_rows) override;
 
     static const DataColumn<T>* TryCast(const Column* column) {
         if (!column || column->data_type == UNKNOWN_TYPE) {
@@ -94,7 +246,16 @@ public:
     }
 protected:
     T FromText(const pugi::xml_text& text);
+    // The plain entries, or all entries decoded into the buffer if the column is compressed. The buffer should be on the
+    // heap, as small allocations freed from a table's storage are not reused
+    const ColumnEntries<T>& DecodedEntries(ColumnEntries<T>& buffer) const;
+
+    PackedEntries<T> _packed_entries;
 };
+
+// Strings are trimmed of trailing spaces rather than copied byte for byte, as defined in Columns.cc
+template<>
+void DataColumn<std::string>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride, size_t first_row);
 }
 
 #endif //VOTABLE_TEST__COLUMNS_H_
\ No newline at end of file
@@ -2,8 +2,16 @@
 #define VOTABLE_TEST__DATACOLUMN_TCC_
 
 #include "Columns.h"
+#include "RadixSort.tcc"
+#include "GroupHashTable.tcc"
 
 #include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <tbb/parallel_sort.h>
+
+// Number of entries processed at a time by aggregations and histograms, sized so that a gathered block stays in cache
+#define VALUE_BLOCK_SIZE int64_t(4096)
 
 namespace carta {
 template<class T>
@@ -79,12 +87,12 @@ void DataColumn<T>::SetEmpty(size_t index) {
 }
 
 template<class T>
-void DataColumn<T>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) {
+void DataColumn<T>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride, size_t first_row) {
     // Shifts by the column's offset
     ptr += data_offset;
-    T* val_ptr = entries.data();
+    T* val_ptr = entries.data() + first_row;
 
-    if (!stride || !data_type_size || num_rows > entries.size()) {
+    if (!stride || !data_type_size || first_row + num_rows > entries.size()) {
         return;
     }
 
@@ -95,23 +103,28 @@ void DataColumn<T>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stri
             uint16_t temp_val;
             memcpy(&temp_val, ptr + stride * i, sizeof(T));
             temp_val = __builtin_bswap16(temp_val);
-            entries[i] = *((T*) &temp_val);
+            val_ptr[i] = *((T*) &temp_val);
         } else if constexpr(sizeof(T) == 4) {
             uint32_t temp_val;
             memcpy(&temp_val, ptr + stride * i, sizeof(T));
             temp_val = __builtin_bswap32(temp_val);
-            entries[i] = *((T*) &temp_val);
+            val_ptr[i] = *((T*) &temp_val);
         } else if constexpr(sizeof(T) == 8) {
             uint64_t temp_val;
             memcpy(&temp_val, ptr + stride * i, sizeof(T));
             temp_val = __builtin_bswap64(temp_val);
-            entries[i] = *((T*) &temp_val);
+            val_ptr[i] = *((T*) &temp_val);
         } else {
             memcpy(val_ptr + i, ptr + stride * i, sizeof(T));
         }
     }
 }
 
+template<class T>
+void DataColumn<T>::SetStorage(const std::shared_ptr<ColumnStorage>& storage) {
+    entries = ColumnEntries<T>(ColumnAllocator<T>(storage));
+}
+
 template<class T>
 void DataColumn<T>::Resize(size_t capacity) {
     entries.resize(capacity);
@@ -119,25 +132,1359 @@ void DataColumn<T>::Resize(size_t capacity) {
 
 template<class T>
 size_t DataColumn<T>::NumEntries() const {
-    return entries.size();
+    return IsCompressed() ? _packed_entries.NumEntries() : entries.size();
+}
+
+// Big-endian key made from the eight characters of a string starting at the given offset, padded with zeros
+inline uint64_t StringPrefixKey(const std::string& val, size_t offset, bool ascending) {
+    uint64_t key = 0;
+    if (offset < val.size()) {
+        memcpy(&key, val.data() + offset, std::min(val.size() - offset, sizeof(key)));
+    }
+    key = __builtin_bswap64(key);
+    return ascending ? key : ~key;
+}
+
+// Sorts string indices by the eight characters starting at the given offset, and then recursively sorts each run of
+// indices with equal keys by the following eight characters. Strings are only compared through their prefix keys
+inline void SortStringIndices(const ColumnEntries<std::string>& entries, int64_t* indices, size_t num_indices, size_t offset, bool ascending) {
+    if (num_indices < 2) {
+        return;
+    }
+
+    std::vector<uint64_t> keys(num_indices);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_indices; i++) {
+        keys[i] = StringPrefixKey(entries[indices[i]], offset, ascending);
+    }
+
+    if (num_indices >= RADIX_SORT_MIN_SIZE) {
+        RadixSortPairs(keys.data(), indices, num_indices);
+    } else {
+        std::vector<std::pair<uint64_t, int64_t>> items(num_indices);
+        for (size_t i = 0; i < num_indices; i++) {
+            items[i] = {keys[i], indices[i]};
+        }
+        std::stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < num_indices; i++) {
+            keys[i] = items[i].first;
+            indices[i] = items[i].second;
+        }
+    }
+
+    // Runs of equal keys only need further sorting if they contain strings longer than the characters compared so far.
+    // Otherwise, strings in a run can only differ by trailing null characters, so they are ordered by length
+    size_t next_offset = offset + sizeof(uint64_t);
+    std::vector<std::pair<size_t, size_t>> runs;
+    std::vector<std::pair<size_t, size_t>> length_runs;
+    size_t run_start = 0;
+    for (size_t i = 1; i <= num_indices; i++) {
+        if (i == num_indices || keys[i] != keys[run_start]) {
+            if (i - run_start > 1) {
+                auto run_begin = indices + run_start;
+                auto run_end = indices + i;
+                if (std::any_of(run_begin, run_end, [&](int64_t index) { return entries[index].size() > next_offset; })) {
+                    runs.emplace_back(run_start, i - run_start);
+                } else if (std::any_of(run_begin, run_end, [&](int64_t index) { return entries[index].size() != entries[*run_begin].size(); })) {
+                    length_runs.emplace_back(run_start, i - run_start);
+                }
+            }
+            run_start = i;
+        }
+    }
+
+    for (auto& [run_offset, run_size]: length_runs) {
+        std::stable_sort(indices + run_offset, indices + run_offset + run_size, [&](int64_t a, int64_t b) {
+            return ascending ? entries[a].size() < entries[b].size() : entries[a].size() > entries[b].size();
+        });
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < runs.size(); i++) {
+        SortStringIndices(entries, indices + runs[i].first, runs[i].second, next_offset, ascending);
+    }
 }
 
 template<class T>
 void DataColumn<T>::SortIndices(IndexList& indices, bool ascending) const {
-    if (indices.empty() || entries.empty()) {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    if (indices.empty() || column_entries.empty()) {
+        return;
+    }
+
+    if constexpr (std::is_arithmetic_v<T>) {
+        // Large numeric sorts gather each entry's sort key once, and then radix sort the (key, index) pairs
+        if (indices.size() >= RADIX_SORT_MIN_SIZE) {
+            int64_t num_indices = indices.size();
+            std::vector<decltype(SortKey(T()))> keys(num_indices);
+#pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < num_indices; i++) {
+                keys[i] = SortKey(column_entries[indices[i]], ascending);
+            }
+            RadixSortPairs(keys.data(), indices.data(), num_indices);
+            return;
+        }
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        SortStringIndices(column_entries, indices.data(), indices.size(), 0, ascending);
         return;
     }
 
+    auto sort_end = indices.end();
+    // NaN entries cannot be ordered, so they are moved to the end and excluded from the sort
+    if constexpr (std::is_floating_point_v<T>) {
+        sort_end = std::partition(indices.begin(), indices.end(), [&](int64_t i) {
+            return !std::isnan(column_entries[i]);
+        });
+    }
+
     // Perform ascending or descending sort
     if (ascending) {
-        std::sort(indices.begin(), indices.end(), [&](int64_t a, int64_t b) {
-            return entries[a] < entries[b];
+        std::sort(indices.begin(), sort_end, [&](int64_t a, int64_t b) {
+            return column_entries[a] < column_entries[b];
+        });
+    } else {
+        std::sort(indices.begin(), sort_end, [&](int64_t a, int64_t b) {
+            return column_entries[a] > column_entries[b];
+        });
+    }
+}
+
+// Finds the first num_top positions in the order given by the before function, using a bounded heap for each thread
+template<class Before>
+std::vector<int64_t> TopPositions(int64_t num_positions, size_t num_top, const Before& before) {
+    if (!num_top || !num_positions) {
+        return std::vector<int64_t>();
+    }
+
+    std::vector<std::vector<int64_t>> heaps(MaxThreadCount());
+#pragma omp parallel
+    {
+        // Each heap has its last position in sort order at the front
+        auto& heap = heaps[ThreadIndex()];
+        heap.reserve(num_top);
+#pragma omp for schedule(static)
+        for (int64_t p = 0; p < num_positions; p++) {
+            if (heap.size() < num_top) {
+                heap.push_back(p);
+                std::push_heap(heap.begin(), heap.end(), before);
+            } else if (before(p, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), before);
+                heap.back() = p;
+                std::push_heap(heap.begin(), heap.end(), before);
+            }
+        }
+    }
+
+    // Merge the heaps of all threads
+    std::vector<int64_t> top_positions;
+    for (auto& heap: heaps) {
+        top_positions.insert(top_positions.end(), heap.begin(), heap.end());
+    }
+    if (top_positions.size() > num_top) {
+        std::nth_element(top_positions.begin(), top_positions.begin() + num_top, top_positions.end(), before);
+        top_positions.resize(num_top);
+    }
+    std::sort(top_positions.begin(), top_positions.end(), before);
+    return top_positions;
+}
+
+template<class T>
+void DataColumn<T>::PartialSortIndices(IndexList& indices, size_t begin, size_t end, bool ascending) const {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    end = std::min(end, indices.size());
+    if (begin >= end || column_entries.empty()) {
+        return;
+    }
+
+    if constexpr (std::is_arithmetic_v<T>) {
+        // Sort (key, index) pairs, so that comparisons do not need to access the entries
+        int64_t num_indices = indices.size();
+        std::vector<std::pair<decltype(SortKey(T())), int64_t>> items(num_indices);
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < num_indices; i++) {
+            items[i] = {SortKey(column_entries[indices[i]], ascending), indices[i]};
+        }
+        std::nth_element(items.begin(), items.begin() + begin, items.end());
+        std::nth_element(items.begin() + begin, items.begin() + end - 1, items.end());
+        tbb::parallel_sort(items.begin() + begin, items.begin() + end);
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < num_indices; i++) {
+            indices[i] = items[i].second;
+        }
+    } else {
+        auto compare = [&](int64_t a, int64_t b) {
+            return ascending ? column_entries[a] < column_entries[b] : column_entries[a] > column_entries[b];
+        };
+        std::nth_element(indices.begin(), indices.begin() + begin, indices.end(), compare);
+        std::nth_element(indices.begin() + begin, indices.begin() + end - 1, indices.end(), compare);
+        tbb::parallel_sort(indices.begin() + begin, indices.begin() + end, compare);
+    }
+}
+
+template<class T>
+void DataColumn<T>::TopIndices(IndexList& indices, bool is_subset, size_t num_top, bool ascending) const {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    int64_t num_entries = column_entries.size();
+    if (is_subset) {
+        // Skip invalid entries
+        indices.erase(std::remove_if(indices.begin(), indices.end(), [&](int64_t i) {
+            return i < 0 || i >= num_entries;
+        }), indices.end());
+    }
+
+    // Positions refer to the existing indices for subsets, or directly to entries otherwise.
+    // Ties are broken by position, so that the result matches a stable sort
+    int64_t num_positions = is_subset ? indices.size() : num_entries;
+    auto row = [&](int64_t p) {
+        return is_subset ? indices[p] : p;
+    };
+
+    std::vector<int64_t> top_positions;
+    if constexpr (std::is_arithmetic_v<T>) {
+        top_positions = TopPositions(num_positions, num_top, [&](int64_t a, int64_t b) {
+            auto key_a = SortKey(column_entries[row(a)], ascending);
+            auto key_b = SortKey(column_entries[row(b)], ascending);
+            return key_a < key_b || (key_a == key_b && a < b);
         });
     } else {
-        std::sort(indices.begin(), indices.end(), [&](int64_t a, int64_t b) {
-            return entries[a] > entries[b];
+        top_positions = TopPositions(num_positions, num_top, [&](int64_t a, int64_t b) {
+            int result = column_entries[row(a)].compare(column_entries[row(b)]);
+            if (!ascending) {
+                result = -result;
+            }
+            return result < 0 || (result == 0 && a < b);
         });
     }
+
+    IndexList top_indices(top_positions.size());
+    for (auto i = 0; i < top_positions.size(); i++) {
+        top_indices[i] = row(top_positions[i]);
+    }
+    indices.swap(top_indices);
+}
+
+template<class T>
+size_t DataColumn<T>::NumValidSorted(const IndexList& sorted_indices) const {
+    if constexpr (std::is_floating_point_v<T>) {
+        auto valid_end = std::partition_point(sorted_indices.begin(), sorted_indices.end(), [&](int64_t i) {
+            return !std::isnan(entries[i]);
+        });
+        return std::distance(sorted_indices.begin(), valid_end);
+    } else {
+        return sorted_indices.size();
+    }
+}
+
+template<class T>
+bool DataColumn<T>::SortedRange(const IndexList& sorted_indices, ComparisonOperator comparison_operator, double value, double secondary_value, size_t& begin, size_t& end) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        if (sorted_indices.size() != NumEntries()) {
+            return false;
+        }
+
+        T typed_value = value;
+        T typed_secondary_value = secondary_value;
+        auto valid_begin = sorted_indices.begin();
+        auto valid_end = valid_begin + NumValidSorted(sorted_indices);
+
+        // Positions of the first entry not less than (lower) or greater than (upper) the given value
+        auto lower = [&](T val) -> size_t {
+            auto it = std::partition_point(valid_begin, valid_end, [&](int64_t i) { return Entry(i) < val; });
+            return std::distance(valid_begin, it);
+        };
+        auto upper = [&](T val) -> size_t {
+            auto it = std::partition_point(valid_begin, valid_end, [&](int64_t i) { return Entry(i) <= val; });
+            return std::distance(valid_begin, it);
+        };
+        size_t num_valid = std::distance(valid_begin, valid_end);
+
+        // Comparisons against NaN always fail
+        if constexpr (std::is_floating_point_v<T>) {
+            bool is_range = comparison_operator == RANGE_INCLUSIVE || comparison_operator == RANGE_EXCLUSIVE;
+            if (comparison_operator != NOT_EQUAL && (std::isnan(typed_value) || (is_range && std::isnan(typed_secondary_value)))) {
+                begin = end = 0;
+                return true;
+            }
+        }
+
+        switch (comparison_operator) {
+            case EQUAL:
+                begin = lower(typed_value);
+                end = upper(typed_value);
+                break;
+            case LESSER:
+                begin = 0;
+                end = lower(typed_value);
+                break;
+            case GREATER:
+                begin = upper(typed_value);
+                end = num_valid;
+                break;
+            case LESSER_OR_EQUAL:
+                begin = 0;
+                end = upper(typed_value);
+                break;
+            case GREATER_OR_EQUAL:
+                begin = lower(typed_value);
+                end = num_valid;
+                break;
+            case RANGE_INCLUSIVE:
+                begin = lower(typed_value);
+                end = upper(typed_secondary_value);
+                break;
+            case RANGE_EXCLUSIVE:
+                begin = upper(typed_value);
+                end = lower(typed_secondary_value);
+                break;
+            default:
+                // NOT_EQUAL matches two disjoint ranges, so cannot be expressed as a single range
+                return false;
+        }
+        end = std::max(begin, end);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+size_t DataColumn<T>::NormalizedKeySize() const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        // String prefix, followed by a flag indicating whether the string was truncated
+        return NORMALIZED_STRING_PREFIX_SIZE + 1;
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        return sizeof(SortKey(T()));
+    } else {
+        return 0;
+    }
+}
+
+template<class T>
+bool DataColumn<T>::NormalizedKeyTruncated(const uint8_t* key) const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        // The flag is inverted for descending keys, but is never zero for a truncated string
+        return key[NORMALIZED_STRING_PREFIX_SIZE] == 1 || key[NORMALIZED_STRING_PREFIX_SIZE] == 0xFE;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+void DataColumn<T>::FillNormalizedKeys(const IndexList& indices, uint8_t* keys, size_t key_stride, bool ascending) const {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    int64_t num_indices = indices.size();
+    if constexpr (std::is_same_v<T, std::string>) {
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < num_indices; i++) {
+            auto& val = column_entries[indices[i]];
+            auto key = keys + i * key_stride;
+            size_t prefix_size = std::min(val.size(), (size_t) NORMALIZED_STRING_PREFIX_SIZE);
+            // Shorter strings are padded with zeros, so that they sort before longer strings with the same prefix
+            memset(key, 0, NORMALIZED_STRING_PREFIX_SIZE);
+            memcpy(key, val.data(), prefix_size);
+            key[NORMALIZED_STRING_PREFIX_SIZE] = val.size() > NORMALIZED_STRING_PREFIX_SIZE ? 1 : 0;
+            if (!ascending) {
+                for (size_t j = 0; j <= NORMALIZED_STRING_PREFIX_SIZE; j++) {
+                    key[j] = ~key[j];
+                }
+            }
+        }
+    } else if constexpr (std::is_arithmetic_v<T>) {
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < num_indices; i++) {
+            auto sort_key = SortKey(column_entries[indices[i]], ascending);
+            // Keys are stored big-endian, so that the most significant byte is compared first
+            if constexpr (sizeof(sort_key) == 2) {
+                sort_key = __builtin_bswap16(sort_key);
+            } else if constexpr (sizeof(sort_key) == 4) {
+                sort_key = __builtin_bswap32(sort_key);
+            } else if constexpr (sizeof(sort_key) == 8) {
+                sort_key = __builtin_bswap64(sort_key);
+            }
+            memcpy(keys + i * key_stride, &sort_key, sizeof(sort_key));
+        }
+    }
+}
+
+template<class T>
+int DataColumn<T>::CompareEntries(int64_t a, int64_t b) const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        return entries[a].compare(entries[b]);
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        auto key_a = SortKey(Entry(a));
+        auto key_b = SortKey(Entry(b));
+        return (key_a > key_b) - (key_a < key_b);
+    } else {
+        return 0;
+    }
+}
+
+// Running statistics of part of a column. Sums use Neumaier compensated summation, and variances are merged using
+// Chan's parallel algorithm
+struct PartialStatistics {
+    int64_t count = 0;
+    int64_t nan_count = 0;
+    double sum = 0;
+    double compensation = 0;
+    double mean = 0;
+    double m2 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void Merge(const PartialStatistics& other) {
+        nan_count += other.nan_count;
+        if (!other.count) {
+            return;
+        }
+
+        for (auto val: {other.sum, other.compensation}) {
+            double new_sum = sum + val;
+            compensation += (std::abs(sum) >= std::abs(val)) ? (sum - new_sum) + val : (val - new_sum) + sum;
+            sum = new_sum;
+        }
+
+        int64_t new_count = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / new_count;
+        m2 += other.m2 + delta * delta * count * other.count / new_count;
+        count = new_count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    // Adds a single value, updating the mean and variance with Welford's algorithm
+    void Add(double val) {
+        if (val != val) {
+            nan_count++;
+            return;
+        }
+
+        double new_sum = sum + val;
+        compensation += (std::abs(sum) >= std::abs(val)) ? (sum - new_sum) + val : (val - new_sum) + sum;
+        sum = new_sum;
+
+        count++;
+        double delta = val - mean;
+        mean += delta / count;
+        m2 += delta * (val - mean);
+        min = std::min(min, val);
+        max = std::max(max, val);
+    }
+
+    ColumnStatistics ToColumnStatistics() const {
+        ColumnStatistics stats;
+        stats.count = count;
+        stats.nan_count = nan_count;
+        stats.sum = sum + compensation;
+        if (count) {
+            stats.mean = stats.sum / count;
+            stats.min = min;
+            stats.max = max;
+            stats.variance = m2 / count;
+            stats.std_dev = std::sqrt(stats.variance);
+        }
+        return stats;
+    }
+
+    // Computes the statistics of a contiguous block of values, with separate vectorizable passes for the sum and variance
+    template<class T>
+    static PartialStatistics FromValues(const T* values, int64_t num_values) {
+        PartialStatistics block;
+        int64_t count = 0;
+        double sum = 0;
+        double min_val = block.min;
+        double max_val = block.max;
+#pragma omp simd reduction(+:count, sum) reduction(min:min_val) reduction(max:max_val)
+        for (int64_t i = 0; i < num_values; i++) {
+            double val = values[i];
+            if (val == val) {
+                count++;
+                sum += val;
+                min_val = std::min(min_val, val);
+                max_val = std::max(max_val, val);
+            }
+        }
+
+        block.count = count;
+        block.nan_count = num_values - count;
+        if (!count) {
+            return block;
+        }
+
+        double mean = sum / count;
+        double m2 = 0;
+#pragma omp simd reduction(+:m2)
+        for (int64_t i = 0; i < num_values; i++) {
+            double val = values[i];
+            if (val == val) {
+                m2 += (val - mean) * (val - mean);
+            }
+        }
+
+        block.sum = sum;
+        block.mean = mean;
+        block.m2 = m2;
+        block.min = min_val;
+        block.max = max_val;
+        return block;
+    }
+};
+
+// Calls func(values, num_values) in parallel on contiguous blocks of the entries at the given indices, or of the entire
+// column if is_subset is false. Subset entries are gathered into a per-thread buffer, skipping invalid indices, as are
+// the entries of compressed columns
+template<class T, class F>
+void ForEachValueBlock(const DataColumn<T>& column, const IndexList& indices, bool is_subset, F func) {
+    auto& entries = column.entries;
+    bool compressed = column.IsCompressed();
+    int64_t num_entries = column.NumEntries();
+    int64_t num_values = is_subset ? indices.size() : num_entries;
+    int64_t num_blocks = (num_values + VALUE_BLOCK_SIZE - 1) / VALUE_BLOCK_SIZE;
+
+#pragma omp parallel
+    {
+        std::vector<T> buffer(is_subset || compressed ? VALUE_BLOCK_SIZE : 0);
+#pragma omp for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * VALUE_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + VALUE_BLOCK_SIZE, num_values);
+            if (is_subset) {
+                int64_t num_gathered = 0;
+                for (auto i = block_start; i < block_end; i++) {
+                    auto index = indices[i];
+                    if (index >= 0 && index < num_entries) {
+                        buffer[num_gathered++] = column.Entry(index);
+                    }
+                }
+                func(buffer.data(), num_gathered);
+            } else if (compressed) {
+                column.CopyEntries(block_start, block_end, buffer.data());
+                func(buffer.data(), block_end - block_start);
+            } else {
+                func(entries.data() + block_start, block_end - block_start);
+            }
+        }
+    }
+}
+
+template<class T>
+bool DataColumn<T>::Aggregate(const IndexList& indices, bool is_subset, ColumnStatistics& stats) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        std::vector<PartialStatistics> thread_statistics(MaxThreadCount());
+        ForEachValueBlock(*this, indices, is_subset, [&](const T* values, int64_t num_values) {
+            thread_statistics[ThreadIndex()].Merge(PartialStatistics::FromValues(values, num_values));
+        });
+
+        PartialStatistics total;
+        for (auto& partial: thread_statistics) {
+            total.Merge(partial);
+        }
+
+        stats = total.ToColumnStatistics();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+bool DataColumn<T>::FillQuantileSketch(const IndexList& indices, bool is_subset, QuantileSketch& sketch) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        // Each thread builds its own sketch, and the sketches are merged at the end
+        std::vector<QuantileSketch> thread_sketches(MaxThreadCount());
+        ForEachValueBlock(*this, indices, is_subset, [&](const T* values, int64_t num_values) {
+            auto& thread_sketch = thread_sketches[ThreadIndex()];
+            for (int64_t i = 0; i < num_values; i++) {
+                thread_sketch.Add(values[i]);
+            }
+        });
+
+        for (auto& thread_sketch: thread_sketches) {
+            sketch.Merge(thread_sketch);
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+bool DataColumn<T>::ExactQuantiles(const IndexList& indices, bool is_subset, bool sorted, const std::vector<double>& fractions,
+    std::vector<double>& quantiles) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        for (auto fraction: fractions) {
+            if (!(fraction >= 0 && fraction <= 1)) {
+                return false;
+            }
+        }
+        quantiles.assign(fractions.size(), NAN);
+
+        // Values are interpolated between the order statistics either side of each quantile's position
+        auto interpolate = [](double fraction, size_t num_values, auto value_at) {
+            double position = fraction * (num_values - 1);
+            size_t lower = position;
+            double weight = position - lower;
+            double lower_value = value_at(lower, false);
+            if (weight == 0 || lower + 1 >= num_values) {
+                return lower_value;
+            }
+            return lower_value + (value_at(lower + 1, true) - lower_value) * weight;
+        };
+
+        if (sorted && is_subset) {
+            size_t num_valid = NumValidSorted(indices);
+            if (num_valid) {
+                for (size_t i = 0; i < fractions.size(); i++) {
+                    quantiles[i] = interpolate(fractions[i], num_valid, [&](size_t position, bool) {
+                        return double(Entry(indices[position]));
+                    });
+                }
+            }
+            return true;
+        }
+
+        // Otherwise, valid entries are gathered and partially sorted with a selection algorithm
+        std::vector<std::vector<T>> thread_values(MaxThreadCount());
+        ForEachValueBlock(*this, indices, is_subset, [&](const T* values, int64_t num_values) {
+            auto& gathered = thread_values[ThreadIndex()];
+            for (int64_t i = 0; i < num_values; i++) {
+                if (values[i] == values[i]) {
+                    gathered.push_back(values[i]);
+                }
+            }
+        });
+        std::vector<T> values;
+        for (auto& gathered: thread_values) {
+            values.insert(values.end(), gathered.begin(), gathered.end());
+            std::vector<T>().swap(gathered);
+        }
+        if (values.empty()) {
+            return true;
+        }
+
+        // Quantiles are selected in ascending order, so that each selection only needs to search the values above the
+        // previous one
+        std::vector<size_t> order(fractions.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return fractions[a] < fractions[b];
+        });
+        auto range_begin = values.begin();
+        for (auto i: order) {
+            quantiles[i] = interpolate(fractions[i], values.size(), [&](size_t position, bool next) {
+                auto it = values.begin() + position;
+                if (next) {
+                    // All values after the previous selection are at least as large, so the next order statistic is their minimum
+                    return double(*std::min_element(it, values.end()));
+                }
+                std::nth_element(range_begin, it, values.end());
+                range_begin = it;
+                return double(*it);
+            });
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+size_t DataColumn<T>::BatchEntrySize(const IndexList& indices, bool is_subset, int64_t start, int64_t end) const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        size_t max_length = 0;
+#pragma omp parallel for reduction(max:max_length)
+        for (int64_t i = start; i < end; i++) {
+            max_length = std::max(max_length, entries[is_subset ? indices[i] : i].size());
+        }
+        return max_length;
+    } else {
+        return sizeof(T);
+    }
+}
+
+template<class T>
+void DataColumn<T>::FillBatchEntries(const IndexList& indices, bool is_subset, int64_t start, int64_t end, uint8_t* output,
+    size_t stride, size_t entry_size) const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        for (int64_t i = start; i < end; i++) {
+            auto& entry = entries[is_subset ? indices[i] : i];
+            size_t length = std::min(entry.size(), entry_size);
+            memcpy(output, entry.data(), length);
+            memset(output + length, 0, entry_size - length);
+            output += stride;
+        }
+    } else if (IsCompressed()) {
+        for (int64_t i = start; i < end; i++) {
+            T val = Entry(is_subset ? indices[i] : i);
+            memcpy(output, &val, sizeof(T));
+            output += stride;
+        }
+    } else if (!is_subset && stride == sizeof(T)) {
+        // Contiguous entries of a full view are copied directly
+        memcpy(output, entries.data() + start, (end - start) * sizeof(T));
+    } else {
+        for (int64_t i = start; i < end; i++) {
+            memcpy(output, &entries[is_subset ? indices[i] : i], sizeof(T));
+            output += stride;
+        }
+    }
+}
+
+template<class T>
+size_t DataColumn<T>::MemorySize() const {
+    size_t memory_size = block_statistics.capacity() * sizeof(BlockStatistics<T>) + _packed_entries.MemorySize();
+    if constexpr (std::is_same_v<T, std::string>) {
+        // Short strings are stored inside the string object itself
+        size_t inline_capacity = std::string().capacity();
+        size_t heap_size = 0;
+#pragma omp parallel for reduction(+:heap_size)
+        for (int64_t i = 0; i < int64_t(entries.size()); i++) {
+            auto capacity = entries[i].capacity();
+            heap_size += capacity > inline_capacity ? capacity + 1 : 0;
+        }
+        memory_size += entries.capacity() * sizeof(std::string) + heap_size;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        memory_size += entries.capacity() / 8;
+    } else {
+        memory_size += entries.capacity() * sizeof(T);
+    }
+    return memory_size;
+}
+
+template<class T>
+bool DataColumn<T>::Compress() {
+    if constexpr (PackedEntries<T>::packable) {
+        if (!IsCompressed() && block_statistics.size() == (entries.size() + STATISTICS_BLOCK_SIZE - 1) / STATISTICS_BLOCK_SIZE &&
+            _packed_entries.Pack(entries.data(), entries.size())) {
+            ColumnEntries<T>(entries.get_allocator()).swap(entries);
+        }
+    }
+    return IsCompressed();
+}
+
+template<class T>
+const ColumnEntries<T>& DataColumn<T>::DecodedEntries(ColumnEntries<T>& buffer) const {
+    if (!IsCompressed()) {
+        return entries;
+    }
+    int64_t num_entries = NumEntries();
+    buffer.resize(num_entries);
+#pragma omp parallel for schedule(static)
+    for (int64_t start = 0; start < num_entries; start += PACKED_BLOCK_SIZE) {
+        CopyEntries(start, std::min(start + PACKED_BLOCK_SIZE, num_entries), buffer.data() + start);
+    }
+    return buffer;
+}
+
+template<class T>
+size_t DataColumn<T>::CacheDataSize() const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        size_t num_chars = 0;
+#pragma omp parallel for reduction(+:num_chars)
+        for (int64_t i = 0; i < int64_t(entries.size()); i++) {
+            num_chars += entries[i].size();
+        }
+        return (entries.size() + 1) * sizeof(uint64_t) + num_chars;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return 0;
+    } else {
+        return NumEntries() * sizeof(T);
+    }
+}
+
+template<class T>
+void DataColumn<T>::FillCacheData(uint8_t* output) const {
+    if constexpr (std::is_same_v<T, std::string>) {
+        auto offsets = reinterpret_cast<uint64_t*>(output);
+        auto chars = output + (entries.size() + 1) * sizeof(uint64_t);
+        offsets[0] = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            offsets[i + 1] = offsets[i] + entries[i].size();
+        }
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < int64_t(entries.size()); i++) {
+            memcpy(chars + offsets[i], entries[i].data(), entries[i].size());
+        }
+    } else if constexpr (!std::is_same_v<T, bool>) {
+        if (!IsCompressed()) {
+            memcpy(output, entries.data(), entries.size() * sizeof(T));
+            return;
+        }
+        // Compressed columns are written as plain entries, decoded a block at a time
+        int64_t num_entries = NumEntries();
+#pragma omp parallel for schedule(static)
+        for (int64_t start = 0; start < num_entries; start += VALUE_BLOCK_SIZE) {
+            T block[VALUE_BLOCK_SIZE];
+            int64_t end = std::min(start + VALUE_BLOCK_SIZE, num_entries);
+            CopyEntries(start, end, block);
+            memcpy(output + start * sizeof(T), block, (end - start) * sizeof(T));
+        }
+    }
+}
+
+template<class T>
+bool DataColumn<T>::LoadCacheData(const uint8_t* data, size_t size, size_t num_rows) {
+    _packed_entries.Clear();
+    if constexpr (std::is_same_v<T, std::string>) {
+        // The row count is checked against the size before it is multiplied, so that a corrupt count cannot overflow
+        if (num_rows >= size / sizeof(uint64_t)) {
+            return false;
+        }
+        size_t offsets_size = (num_rows + 1) * sizeof(uint64_t);
+        auto offsets = reinterpret_cast<const uint64_t*>(data);
+        auto chars = reinterpret_cast<const char*>(data + offsets_size);
+        if (offsets[0] != 0 || offsets[num_rows] != size - offsets_size) {
+            return false;
+        }
+        entries.resize(num_rows);
+        bool valid = true;
+#pragma omp parallel for schedule(static) reduction(&&:valid)
+        for (int64_t i = 0; i < int64_t(num_rows); i++) {
+            if (offsets[i] <= offsets[i + 1] && offsets[i + 1] <= offsets[num_rows]) {
+                entries[i].assign(chars + offsets[i], offsets[i + 1] - offsets[i]);
+            } else {
+                valid = false;
+            }
+        }
+        return valid;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return false;
+    } else {
+        if (size % sizeof(T) || num_rows != size / sizeof(T)) {
+            return false;
+        }
+        entries.resize(num_rows);
+        // Copied in parallel, so that the pages of the entries are first touched by the threads that later scan them
+        int64_t num_blocks = (int64_t(num_rows) + STATISTICS_BLOCK_SIZE - 1) / STATISTICS_BLOCK_SIZE;
+#pragma omp parallel for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * STATISTICS_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + STATISTICS_BLOCK_SIZE, int64_t(num_rows));
+            memcpy(entries.data() + block_start, data + block_start * sizeof(T), (block_end - block_start) * sizeof(T));
+        }
+        return true;
+    }
+}
+
+template<class T>
+bool DataColumn<T>::GroupIndices(const IndexList& indices, bool is_subset, IndexList& group_ids, IndexList& group_rows, IndexList& group_sizes) const {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    int64_t num_entries = column_entries.size();
+    int64_t num_values = is_subset ? indices.size() : num_entries;
+    auto row_at = [&](int64_t i) -> int64_t {
+        int64_t row = is_subset ? indices[i] : i;
+        return (row >= 0 && row < num_entries) ? row : -1;
+    };
+
+    group_ids.resize(num_values);
+    group_rows.clear();
+    group_sizes.clear();
+
+    // Integer keys with a small range are mapped directly to slots of an array. Slots are visited in ascending order,
+    // so groups are ordered by key without sorting
+    if constexpr (std::is_integral_v<T>) {
+        T min_val = std::numeric_limits<T>::max();
+        T max_val = std::numeric_limits<T>::lowest();
+#pragma omp parallel for reduction(min:min_val) reduction(max:max_val)
+        for (int64_t i = 0; i < num_values; i++) {
+            auto row = row_at(i);
+            if (row >= 0) {
+                min_val = std::min(min_val, column_entries[row]);
+                max_val = std::max(max_val, column_entries[row]);
+            }
+        }
+
+        auto slot_of = [&](T val) {
+            return size_t(SortKey(val)) - size_t(SortKey(min_val));
+        };
+        if (min_val <= max_val && slot_of(max_val) < DIRECT_GROUP_MAX_RANGE) {
+            size_t num_slots = slot_of(max_val) + 1;
+            std::vector<IndexList> thread_counts(MaxThreadCount());
+            std::vector<IndexList> thread_first_rows(MaxThreadCount());
+#pragma omp parallel
+            {
+                auto& counts = thread_counts[ThreadIndex()];
+                auto& first_rows = thread_first_rows[ThreadIndex()];
+                counts.assign(num_slots, 0);
+                first_rows.assign(num_slots, -1);
+#pragma omp for schedule(static)
+                for (int64_t i = 0; i < num_values; i++) {
+                    auto row = row_at(i);
+                    if (row >= 0) {
+                        auto slot = slot_of(column_entries[row]);
+                        if (!counts[slot]++) {
+                            first_rows[slot] = row;
+                        }
+                    }
+                }
+            }
+
+            // Static scheduling gives each thread a contiguous range of rows in order, so the first thread to find a
+            // key holds its first row
+            IndexList slot_groups(num_slots, -1);
+            for (size_t slot = 0; slot < num_slots; slot++) {
+                int64_t count = 0;
+                int64_t first_row = -1;
+                for (size_t t = 0; t < thread_counts.size(); t++) {
+                    if (!thread_counts[t].empty() && thread_counts[t][slot]) {
+                        count += thread_counts[t][slot];
+                        if (first_row < 0) {
+                            first_row = thread_first_rows[t][slot];
+                        }
+                    }
+                }
+                if (count) {
+                    slot_groups[slot] = group_rows.size();
+                    group_rows.push_back(first_row);
+                    group_sizes.push_back(count);
+                }
+            }
+
+#pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < num_values; i++) {
+                auto row = row_at(i);
+                group_ids[i] = row >= 0 ? slot_groups[slot_of(column_entries[row])] : -1;
+            }
+            return true;
+        }
+    }
+
+    // Otherwise, keys are hashed. Numeric keys are compared using their sort keys, so that all NaNs form a single group
+    auto key_of = [&](int64_t row) -> decltype(auto) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return column_entries[row];
+        } else {
+            T val = column_entries[row];
+            if constexpr (std::is_floating_point_v<T>) {
+                // Positive and negative zeros are equal, but have different sort keys
+                if (val == 0) {
+                    val = 0;
+                }
+            }
+            return SortKey(val);
+        }
+    };
+    auto hash_of = [&](int64_t row) -> uint64_t {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return std::hash<std::string>()(column_entries[row]);
+        } else {
+            return MixHash(key_of(row));
+        }
+    };
+    auto equal = [&](int64_t a, int64_t b) {
+        return key_of(a) == key_of(b);
+    };
+
+    // Each thread groups a contiguous range of rows with its own table, and the tables are then merged
+    std::vector<GroupHashTable> thread_tables(MaxThreadCount());
+    std::vector<IndexList> thread_group_maps(MaxThreadCount());
+#pragma omp parallel
+    {
+        int thread_index = ThreadIndex();
+        int num_threads = ThreadCount();
+        int64_t chunk_start = num_values * thread_index / num_threads;
+        int64_t chunk_end = num_values * (thread_index + 1) / num_threads;
+        auto& table = thread_tables[thread_index];
+        for (auto i = chunk_start; i < chunk_end; i++) {
+            auto row = row_at(i);
+            group_ids[i] = row >= 0 ? table.Insert(row, hash_of(row), 1, equal) : -1;
+        }
+
+#pragma omp barrier
+#pragma omp single
+        {
+            // Merging the tables in thread order keeps the first row of each key as its representative
+            GroupHashTable merged_table;
+            for (int t = 0; t < num_threads; t++) {
+                auto& local_table = thread_tables[t];
+                auto& group_map = thread_group_maps[t];
+                group_map.resize(local_table.NumGroups());
+                for (size_t group = 0; group < local_table.NumGroups(); group++) {
+                    group_map[group] = merged_table.Insert(local_table.group_rows[group], local_table.group_hashes[group],
+                        local_table.group_sizes[group], equal);
+                }
+            }
+
+            // Groups are numbered in ascending order of their keys
+            IndexList order(merged_table.NumGroups());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+                return key_of(merged_table.group_rows[a]) < key_of(merged_table.group_rows[b]);
+            });
+            IndexList ranks(order.size());
+            for (size_t rank = 0; rank < order.size(); rank++) {
+                ranks[order[rank]] = rank;
+                group_rows.push_back(merged_table.group_rows[order[rank]]);
+                group_sizes.push_back(merged_table.group_sizes[order[rank]]);
+            }
+            for (int t = 0; t < num_threads; t++) {
+                for (auto& group: thread_group_maps[t]) {
+                    group = ranks[group];
+                }
+            }
+        }
+
+        auto& group_map = thread_group_maps[thread_index];
+        for (auto i = chunk_start; i < chunk_end; i++) {
+            if (group_ids[i] >= 0) {
+                group_ids[i] = group_map[group_ids[i]];
+            }
+        }
+    }
+    return true;
+}
+
+template<class T>
+bool DataColumn<T>::AggregateGroups(const IndexList& indices, bool is_subset, const IndexList& group_ids, size_t num_groups,
+    std::vector<ColumnStatistics>& stats) const {
+    // Compressed columns are decoded for the duration of the operation
+    ColumnEntries<T> decoded;
+    auto& column_entries = DecodedEntries(decoded);
+
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        int64_t num_entries = column_entries.size();
+        int64_t num_values = is_subset ? indices.size() : num_entries;
+        if (group_ids.size() != num_values) {
+            return false;
+        }
+        auto row_at = [&](int64_t i) -> int64_t {
+            int64_t row = is_subset ? indices[i] : i;
+            return (row >= 0 && row < num_entries) ? row : -1;
+        };
+
+        std::vector<PartialStatistics> totals(num_groups);
+        int max_threads = MaxThreadCount();
+        if (num_groups * max_threads <= num_values) {
+            // Each thread accumulates its rows into its own partial statistics for each group, which are merged at the end
+            std::vector<std::vector<PartialStatistics>> thread_statistics(max_threads);
+#pragma omp parallel
+            {
+                auto& partials = thread_statistics[ThreadIndex()];
+                partials.resize(num_groups);
+#pragma omp for schedule(static)
+                for (int64_t i = 0; i < num_values; i++) {
+                    auto group = group_ids[i];
+                    auto row = row_at(i);
+                    if (group >= 0 && group < num_groups && row >= 0) {
+                        partials[group].Add(column_entries[row]);
+                    }
+                }
+            }
+#pragma omp parallel for schedule(static)
+            for (int64_t group = 0; group < num_groups; group++) {
+                for (auto& partials: thread_statistics) {
+                    if (!partials.empty()) {
+                        totals[group].Merge(partials[group]);
+                    }
+                }
+            }
+        } else {
+            // With many groups, per-thread copies of the statistics would use too much memory, so each thread instead
+            // scans all rows and accumulates only those belonging to its own range of groups
+#pragma omp parallel
+            {
+                int64_t thread_index = ThreadIndex();
+                int64_t num_threads = ThreadCount();
+                int64_t group_start = num_groups * thread_index / num_threads;
+                int64_t group_end = num_groups * (thread_index + 1) / num_threads;
+                for (int64_t i = 0; i < num_values; i++) {
+                    auto group = group_ids[i];
+                    auto row = row_at(i);
+                    if (group >= group_start && group < group_end && row >= 0) {
+                        totals[group].Add(column_entries[row]);
+                    }
+                }
+            }
+        }
+
+        stats.resize(num_groups);
+#pragma omp parallel for schedule(static)
+        for (int64_t group = 0; group < num_groups; group++) {
+            stats[group] = totals[group].ToColumnStatistics();
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+bool DataColumn<T>::FillHistogram(const IndexList& indices, bool is_subset, int num_bins, bool log_scale, double min_val, double max_val,
+    ColumnHistogram& histogram) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        if (num_bins <= 0) {
+            return false;
+        }
+
+        // Missing range limits are found from the entries within the range, ignoring entries that cannot be binned
+        if (std::isnan(min_val) || std::isnan(max_val)) {
+            double lower_limit = std::isnan(min_val) ? -std::numeric_limits<double>::infinity() : min_val;
+            double upper_limit = std::isnan(max_val) ? std::numeric_limits<double>::infinity() : max_val;
+            if (log_scale) {
+                lower_limit = std::max(lower_limit, std::numeric_limits<double>::denorm_min());
+            }
+            std::vector<double> thread_min(MaxThreadCount(), std::numeric_limits<double>::infinity());
+            std::vector<double> thread_max(MaxThreadCount(), -std::numeric_limits<double>::infinity());
+            ForEachValueBlock(*this, indices, is_subset, [&](const T* values, int64_t num_values) {
+                double block_min = thread_min[ThreadIndex()];
+                double block_max = thread_max[ThreadIndex()];
+#pragma omp simd reduction(min:block_min) reduction(max:block_max)
+                for (int64_t i = 0; i < num_values; i++) {
+                    double val = values[i];
+                    if (val >= lower_limit && val <= upper_limit) {
+                        block_min = std::min(block_min, val);
+                        block_max = std::max(block_max, val);
+                    }
+                }
+                thread_min[ThreadIndex()] = block_min;
+                thread_max[ThreadIndex()] = block_max;
+            });
+            double found_min = *std::min_element(thread_min.begin(), thread_min.end());
+            double found_max = *std::max_element(thread_max.begin(), thread_max.end());
+            min_val = std::isnan(min_val) ? found_min : min_val;
+            max_val = std::isnan(max_val) ? found_max : max_val;
+        }
+
+        histogram = ColumnHistogram();
+        histogram.log_scale = log_scale;
+        histogram.counts.assign(num_bins, 0);
+
+        // Without any entries in the range, the histogram is empty
+        if (std::isinf(min_val) || std::isinf(max_val) || min_val > max_val) {
+            return true;
+        }
+        if (log_scale && min_val <= 0) {
+            return false;
+        }
+        histogram.min = min_val;
+        histogram.max = max_val;
+
+        double lower = log_scale ? std::log10(min_val) : min_val;
+        double upper = log_scale ? std::log10(max_val) : max_val;
+        double scale = upper > lower ? num_bins / (upper - lower) : 0;
+        double max_bin = num_bins - 1;
+
+        std::vector<std::vector<int64_t>> thread_counts(MaxThreadCount(), std::vector<int64_t>(num_bins, 0));
+        ForEachValueBlock(*this, indices, is_subset, [&](const T* values, int64_t num_values) {
+            // Bin indices are computed in a vectorizable pass, with -1 marking entries outside the range
+            int32_t bins[VALUE_BLOCK_SIZE];
+            if (log_scale) {
+#pragma omp simd
+                for (int64_t i = 0; i < num_values; i++) {
+                    double val = values[i];
+                    bool in_range = val >= min_val && val <= max_val;
+                    double position = in_range ? std::min((std::log10(val) - lower) * scale, max_bin) : -1.0;
+                    bins[i] = position;
+                }
+            } else {
+#pragma omp simd
+                for (int64_t i = 0; i < num_values; i++) {
+                    double val = values[i];
+                    bool in_range = val >= min_val && val <= max_val;
+                    double position = in_range ? std::min((val - lower) * scale, max_bin) : -1.0;
+                    bins[i] = position;
+                }
+            }
+
+            auto& counts = thread_counts[ThreadIndex()];
+            for (int64_t i = 0; i < num_values; i++) {
+                if (bins[i] >= 0) {
+                    counts[bins[i]]++;
+                }
+            }
+        });
+
+        for (auto& counts: thread_counts) {
+            for (int bin = 0; bin < num_bins; bin++) {
+                histogram.counts[bin] += counts[bin];
+            }
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+void DataColumn<T>::ComputeBlockStatistics() {
+    // The statistics of a compressed column were computed before it was compressed
+    if (IsCompressed()) {
+        return;
+    }
+    block_statistics.clear();
+
+    // Only applies to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        int64_t num_entries = entries.size();
+        int64_t num_blocks = (num_entries + STATISTICS_BLOCK_SIZE - 1) / STATISTICS_BLOCK_SIZE;
+        block_statistics.resize(num_blocks);
+
+#pragma omp parallel for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * STATISTICS_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + STATISTICS_BLOCK_SIZE, num_entries);
+            T min_val = std::numeric_limits<T>::max();
+            T max_val = std::numeric_limits<T>::lowest();
+            int64_t nan_count = 0;
+            for (auto i = block_start; i < block_end; i++) {
+                T val = entries[i];
+                if constexpr (std::is_floating_point_v<T>) {
+                    if (std::isnan(val)) {
+                        nan_count++;
+                        continue;
+                    }
+                }
+                min_val = std::min(min_val, val);
+                max_val = std::max(max_val, val);
+            }
+            block_statistics[block] = {min_val, max_val, nan_count};
+        }
+    }
+}
+
+enum BlockFilterResult {
+    BLOCK_NONE_MATCH,
+    BLOCK_PARTIAL_MATCH,
+    BLOCK_ALL_MATCH
+};
+
+// Determines from its statistics whether none, all or only some of a block's entries can pass a filter
+template<class T>
+BlockFilterResult ClassifyBlock(const BlockStatistics<T>& stats, int64_t block_size, ComparisonOperator comparison_operator, T value, T secondary_value) {
+    bool has_nans = stats.nan_count > 0;
+    // Blocks containing only NaNs fail every comparison except NOT_EQUAL
+    if (stats.nan_count >= block_size) {
+        return comparison_operator == NOT_EQUAL ? BLOCK_ALL_MATCH : BLOCK_NONE_MATCH;
+    }
+
+    // Determine whether all or none of the non-NaN entries in the block pass the filter
+    bool all_pass = false;
+    bool none_pass = false;
+    switch (comparison_operator) {
+        case EQUAL:
+            all_pass = stats.min == value && stats.max == value;
+            none_pass = value < stats.min || value > stats.max;
+            break;
+        case NOT_EQUAL:
+            all_pass = value < stats.min || value > stats.max;
+            none_pass = stats.min == value && stats.max == value;
+            break;
+        case LESSER:
+            all_pass = stats.max < value;
+            none_pass = stats.min >= value;
+            break;
+        case GREATER:
+            all_pass = stats.min > value;
+            none_pass = stats.max <= value;
+            break;
+        case LESSER_OR_EQUAL:
+            all_pass = stats.max <= value;
+            none_pass = stats.min > value;
+            break;
+        case GREATER_OR_EQUAL:
+            all_pass = stats.min >= value;
+            none_pass = stats.max < value;
+            break;
+        case RANGE_INCLUSIVE:
+            all_pass = stats.min >= value && stats.max <= secondary_value;
+            none_pass = stats.max < value || stats.min > secondary_value;
+            break;
+        case RANGE_EXCLUSIVE:
+            all_pass = stats.min > value && stats.max < secondary_value;
+            none_pass = stats.max <= value || stats.min >= secondary_value;
+            break;
+        default:
+            break;
+    }
+
+    // NaN entries only pass the NOT_EQUAL comparison
+    if (has_nans) {
+        if (comparison_operator == NOT_EQUAL) {
+            return all_pass ? BLOCK_ALL_MATCH : BLOCK_PARTIAL_MATCH;
+        }
+        return none_pass ? BLOCK_NONE_MATCH : BLOCK_PARTIAL_MATCH;
+    }
+
+    if (all_pass) {
+        return BLOCK_ALL_MATCH;
+    } else if (none_pass) {
+        return BLOCK_NONE_MATCH;
+    }
+    return BLOCK_PARTIAL_MATCH;
+}
+
+// Inclusive range [low, high] of integer entries passing a comparison, or failing it if invert is set. Returns false if no
+// entries can pass
+template<class T>
+bool IntegerFilterRange(ComparisonOperator comparison_operator, T value, T secondary_value, T& low, T& high, bool& invert) {
+    constexpr T lowest = std::numeric_limits<T>::lowest();
+    constexpr T max = std::numeric_limits<T>::max();
+    low = lowest;
+    high = max;
+    invert = false;
+    switch (comparison_operator) {
+        case EQUAL:
+            low = high = value;
+            return true;
+        case NOT_EQUAL:
+            low = high = value;
+            invert = true;
+            return true;
+        case LESSER:
+            if (value == lowest) {
+                return false;
+            }
+            high = value - 1;
+            return true;
+        case GREATER:
+            if (value == max) {
+                return false;
+            }
+            low = value + 1;
+            return true;
+        case LESSER_OR_EQUAL:
+            high = value;
+            return true;
+        case GREATER_OR_EQUAL:
+            low = value;
+            return true;
+        case RANGE_INCLUSIVE:
+            low = value;
+            high = secondary_value;
+            return true;
+        case RANGE_EXCLUSIVE:
+            if (value == max || secondary_value == lowest) {
+                return false;
+            }
+            low = value + 1;
+            high = secondary_value - 1;
+            return true;
+        default:
+            return false;
+    }
 }
 
 template<class T>
@@ -147,8 +1494,29 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
         T typed_value = value;
         T typed_secondary_value = secondary_value;
 
+        auto filter_pass = [&](T val) {
+            return (comparison_operator == EQUAL && val == typed_value)
+                || (comparison_operator == NOT_EQUAL && val != typed_value)
+                || (comparison_operator == LESSER && val < typed_value)
+                || (comparison_operator == GREATER && val > typed_value)
+                || (comparison_operator == LESSER_OR_EQUAL && val <= typed_value)
+                || (comparison_operator == GREATER_OR_EQUAL && val >= typed_value)
+                || (comparison_operator == RANGE_INCLUSIVE && val >= typed_value && val <= typed_secondary_value)
+                || (comparison_operator == RANGE_EXCLUSIVE && val > typed_value && val < typed_secondary_value);
+        };
+
         IndexList matching_indices;
-        size_t num_entries = entries.size();
+        int64_t num_entries = NumEntries();
+        int64_t num_blocks = (num_entries + STATISTICS_BLOCK_SIZE - 1) / STATISTICS_BLOCK_SIZE;
+
+        // Classify each block using its statistics. If statistics are missing, every block must be scanned
+        std::vector<BlockFilterResult> block_results(num_blocks, BLOCK_PARTIAL_MATCH);
+        if (block_statistics.size() == num_blocks) {
+            for (int64_t block = 0; block < num_blocks; block++) {
+                int64_t block_size = std::min((int64_t) STATISTICS_BLOCK_SIZE, num_entries - block * STATISTICS_BLOCK_SIZE);
+                block_results[block] = ClassifyBlock(block_statistics[block], block_size, comparison_operator, typed_value, typed_secondary_value);
+            }
+        }
 
         if (is_subset) {
             for (auto i: existing_indices) {
@@ -156,32 +1524,32 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
                 if (i < 0 || i >= num_entries) {
                     continue;
                 }
-                T val = entries[i];
-                bool filter_pass = (comparison_operator == EQUAL && val == typed_value)
-                    || (comparison_operator == NOT_EQUAL && val != typed_value)
-                    || (comparison_operator == LESSER && val < typed_value)
-                    || (comparison_operator == GREATER && val > typed_value)
-                    || (comparison_operator == LESSER_OR_EQUAL && val <= typed_value)
-                    || (comparison_operator == GREATER_OR_EQUAL && val >= typed_value)
-                    || (comparison_operator == RANGE_INCLUSIVE && val >= typed_value && val <= typed_secondary_value)
-                    || (comparison_operator == RANGE_EXCLUSIVE && val > typed_value && val < typed_secondary_value);
-                if (filter_pass) {
+                auto block_result = block_results[i / STATISTICS_BLOCK_SIZE];
+                if (block_result == BLOCK_ALL_MATCH || (block_result == BLOCK_PARTIAL_MATCH && filter_pass(Entry(i)))) {
                     matching_indices.push_back(i);
                 }
             }
+        } else if (IsCompressed()) {
+            // Packed entries are compared without decoding, as codes relative to each packed block's minimum
+            if constexpr (PackedEntries<T>::packable) {
+                T low, high;
+                bool invert;
+                if (IntegerFilterRange(comparison_operator, typed_value, typed_secondary_value, low, high, invert)) {
+                    _packed_entries.Filter(low, high, invert, matching_indices);
+                }
+            }
         } else {
-            for (auto i = 0; i < num_entries; i++) {
-                T val = entries[i];
-                bool filter_pass = (comparison_operator == EQUAL && val == typed_value)
-                    || (comparison_operator == NOT_EQUAL && val != typed_value)
-                    || (comparison_operator == LESSER && val < typed_value)
-                    || (comparison_operator == GREATER && val > typed_value)
-                    || (comparison_operator == LESSER_OR_EQUAL && val <= typed_value)
-                    || (comparison_operator == GREATER_OR_EQUAL && val >= typed_value)
-                    || (comparison_operator == RANGE_INCLUSIVE && val >= typed_value && val <= typed_secondary_value)
-                    || (comparison_operator == RANGE_EXCLUSIVE && val > typed_value && val < typed_secondary_value);
-                if (filter_pass) {
-                    matching_indices.push_back(i);
+            for (int64_t block = 0; block < num_blocks; block++) {
+                int64_t block_start = block * STATISTICS_BLOCK_SIZE;
+                int64_t block_end = std::min(block_start + STATISTICS_BLOCK_SIZE, num_entries);
+                auto block_result = block_results[block];
+                if (block_result == BLOCK_NONE_MATCH) {
+                    continue;
+                }
+                for (auto i = block_start; i < block_end; i++) {
+                    if (block_result == BLOCK_ALL_MATCH || filter_pass(entries[i])) {
+                        matching_indices.push_back(i);
+                    }
                 }
             }
         }
@@ -0,0 +1,141 @@
+#include "Geometry.h"
+
+#include <algorithm>
+
+namespace carta {
+
+using namespace std;
+
+PolygonGrid::PolygonGrid(const std::vector<double>& polygon_x, const std::vector<double>& polygon_y, int size) {
+    size_t num_vertices = polygon_x.size();
+    if (num_vertices < 3 || polygon_y.size() != num_vertices || size < 1) {
+        return;
+    }
+    for (size_t i = 0; i < num_vertices; i++) {
+        if (!isfinite(polygon_x[i]) || !isfinite(polygon_y[i])) {
+            return;
+        }
+    }
+
+    _x_min = *min_element(polygon_x.begin(), polygon_x.end());
+    _x_max = *max_element(polygon_x.begin(), polygon_x.end());
+    _y_min = *min_element(polygon_y.begin(), polygon_y.end());
+    _y_max = *max_element(polygon_y.begin(), polygon_y.end());
+
+    // Edges are stored with the same vertex order as PointInPolygon, so that the exact test gives identical results
+    vector<Edge> edges;
+    for (size_t i = 0, j = num_vertices - 1; i < num_vertices; j = i++) {
+        edges.push_back({polygon_x[j], polygon_y[j], polygon_x[i], polygon_y[i]});
+    }
+
+    // Polygons without area fall back to a single crossed cell
+    if (!(_x_max > _x_min && _y_max > _y_min)) {
+        _size = 1;
+        _x_scale = 0;
+        _y_scale = 0;
+        _cells.assign(1, CROSSED);
+        _row_edges.assign(1, edges);
+        return;
+    }
+
+    _size = size;
+    _x_scale = size / (_x_max - _x_min);
+    _y_scale = size / (_y_max - _y_min);
+    _cells.assign(int64_t(size) * size, OUTSIDE);
+    _row_edges.resize(size);
+
+    auto clamp_cell = [size](double position) {
+        return int(clamp(floor(position), 0.0, size - 1.0));
+    };
+
+    for (auto& edge: edges) {
+        double edge_y_min = min(edge.y_start, edge.y_end);
+        double edge_y_max = max(edge.y_start, edge.y_end);
+        int first_row = clamp_cell((edge_y_min - _y_min) * _y_scale - POLYGON_CELL_MARGIN);
+        int last_row = clamp_cell((edge_y_max - _y_min) * _y_scale + POLYGON_CELL_MARGIN);
+
+        for (int row = first_row; row <= last_row; row++) {
+            _row_edges[row].push_back(edge);
+
+            // Mark the cells covered by the part of the edge within this row
+            double x_low, x_high;
+            if (edge.y_start == edge.y_end) {
+                x_low = min(edge.x_start, edge.x_end);
+                x_high = max(edge.x_start, edge.x_end);
+            } else {
+                double band_start = max(edge_y_min, _y_min + (row - POLYGON_CELL_MARGIN) / _y_scale);
+                double band_end = min(edge_y_max, _y_min + (row + 1 + POLYGON_CELL_MARGIN) / _y_scale);
+                double slope = (edge.x_end - edge.x_start) / (edge.y_end - edge.y_start);
+                double x_band_start = edge.x_start + (band_start - edge.y_start) * slope;
+                double x_band_end = edge.x_start + (band_end - edge.y_start) * slope;
+                x_low = min(x_band_start, x_band_end);
+                x_high = max(x_band_start, x_band_end);
+            }
+
+            int first_column = clamp_cell((x_low - _x_min) * _x_scale - POLYGON_CELL_MARGIN);
+            int last_column = clamp_cell((x_high - _x_min) * _x_scale + POLYGON_CELL_MARGIN);
+            for (int column = first_column; column <= last_column; column++) {
+                _cells[int64_t(row) * size + column] = CROSSED;
+            }
+        }
+    }
+
+    // Cells not crossed by any edge lie entirely on one side of the polygon boundary, given by their centre
+    for (int row = 0; row < size; row++) {
+        double y = _y_min + (row + 0.5) / _y_scale;
+        for (int column = 0; column < size; column++) {
+            auto& cell = _cells[int64_t(row) * size + column];
+            if (cell != CROSSED) {
+                cell = RowContains(row, _x_min + (column + 0.5) / _x_scale, y) ? INSIDE : OUTSIDE;
+            }
+        }
+    }
+}
+
+bool PolygonGrid::IsValid() const {
+    return !_cells.empty();
+}
+
+void PolygonGrid::Contains(const double* x, const double* y, int64_t num_points, uint8_t* inside) const {
+    if (!IsValid()) {
+        fill(inside, inside + num_points, OUTSIDE);
+        return;
+    }
+
+    // Cells are looked up in a vectorizable pass, leaving only points in crossed cells for the exact test
+    double x_min = _x_min, x_max = _x_max, y_min = _y_min, y_max = _y_max;
+    double x_scale = _x_scale, y_scale = _y_scale;
+    double max_cell = _size - 1;
+    int64_t size = _size;
+    auto cells = _cells.data();
+#pragma omp simd
+    for (int64_t i = 0; i < num_points; i++) {
+        bool in_box = x[i] >= x_min && x[i] <= x_max && y[i] >= y_min && y[i] <= y_max;
+        int64_t column = in_box ? std::min((x[i] - x_min) * x_scale, max_cell) : 0;
+        int64_t row = in_box ? std::min((y[i] - y_min) * y_scale, max_cell) : 0;
+        inside[i] = in_box ? cells[row * size + column] : uint8_t(OUTSIDE);
+    }
+
+    for (int64_t i = 0; i < num_points; i++) {
+        if (inside[i] == CROSSED) {
+            inside[i] = RowContains(Row(y[i]), x[i], y[i]);
+        }
+    }
+}
+
+int PolygonGrid::Row(double y) const {
+    return std::min(int64_t((y - _y_min) * _y_scale), int64_t(_size - 1));
+}
+
+bool PolygonGrid::RowContains(int row, double x, double y) const {
+    bool inside = false;
+    for (auto& edge: _row_edges[row]) {
+        if ((edge.y_end > y) != (edge.y_start > y) &&
+            x < edge.x_start + (y - edge.y_start) * (edge.x_end - edge.x_start) / (edge.y_end - edge.y_start)) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef VOTABLE_TEST__GEOMETRY_H_
+#define VOTABLE_TEST__GEOMETRY_H_
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Number of cells along each axis of the grid used to classify points against a polygon
+#define POLYGON_GRID_SIZE 64
+// Fraction of a cell by which polygon edges are widened when marking crossed cells, to absorb rounding at cell boundaries
+#define POLYGON_CELL_MARGIN 0.01
+
+namespace carta {
+
+// Unit vector pointing towards the given spherical coordinates, in degrees
+inline void UnitVector(double ra, double dec, double* vector) {
+    double ra_rad = ra * M_PI / 180.0;
+    double dec_rad = dec * M_PI / 180.0;
+    vector[0] = std::cos(dec_rad) * std::cos(ra_rad);
+    vector[1] = std::cos(dec_rad) * std::sin(ra_rad);
+    vector[2] = std::sin(dec_rad);
+}
+
+// Even-odd test of whether a point lies inside a planar polygon, with the polygon closed implicitly
+inline bool PointInPolygon(double x, double y, const std::vector<double>& polygon_x, const std::vector<double>& polygon_y) {
+    bool inside = false;
+    size_t num_vertices = polygon_x.size();
+    for (size_t i = 0, j = num_vertices - 1; i < num_vertices; j = i++) {
+        if ((polygon_y[i] > y) != (polygon_y[j] > y) &&
+            x < polygon_x[j] + (y - polygon_y[j]) * (polygon_x[i] - polygon_x[j]) / (polygon_y[i] - polygon_y[j])) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// Uniform grid over the bounding box of a planar polygon, with each cell classified as inside or outside the polygon, or
+// crossed by one of its edges. Only points in crossed cells need an exact test, which uses just the edges overlapping the
+// point's row of cells and gives the same result as PointInPolygon
+class PolygonGrid {
+public:
+    PolygonGrid(const std::vector<double>& polygon_x, const std::vector<double>& polygon_y, int size = POLYGON_GRID_SIZE);
+
+    // Polygons need at least three vertices, all finite
+    bool IsValid() const;
+    // Sets inside[i] to 1 if point i lies inside the polygon, and to 0 otherwise
+    void Contains(const double* x, const double* y, int64_t num_points, uint8_t* inside) const;
+
+protected:
+    // Cell types double as the results of Contains, with crossed cells resolved by the exact test
+    enum CellType : uint8_t { OUTSIDE = 0, INSIDE = 1, CROSSED = 2 };
+
+    struct Edge {
+        double x_start;
+        double y_start;
+        double x_end;
+        double y_end;
+    };
+
+    int Row(double y) const;
+    bool RowContains(int row, double x, double y) const;
+
+    int _size;
+    double _x_min;
+    double _x_max;
+    double _y_min;
+    double _y_max;
+    double _x_scale;
+    double _y_scale;
+    std::vector<uint8_t> _cells;
+    std::vector<std::vector<Edge>> _row_edges;
+};
+
+}
+
+#endif //VOTABLE_TEST__GEOMETRY_H_
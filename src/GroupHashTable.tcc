@@ -0,0 +1,100 @@
+#ifndef VOTABLE_TEST__GROUPHASHTABLE_TCC_
+#define VOTABLE_TEST__GROUPHASHTABLE_TCC_
+
+#include <cstdint>
+#include <vector>
+
+#include "Columns.h"
+
+// Grouping of integer columns uses a directly-indexed array instead of a hash table if the range of the entries is at most this size
+#define DIRECT_GROUP_MAX_RANGE (64 * 1024)
+
+namespace carta {
+
+// Finalizer of MurmurHash3, used to spread key bits over the full hash
+inline uint64_t MixHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Open-addressing hash table with linear probing, mapping the keys of a column to group IDs in order of insertion.
+// Each key is represented by the first row inserted with that key, and hashes are stored to avoid most key comparisons
+class GroupHashTable {
+public:
+    IndexList group_rows;
+    IndexList group_sizes;
+    std::vector<uint64_t> group_hashes;
+
+    GroupHashTable() {
+        _slots.assign(16, -1);
+    }
+
+    size_t NumGroups() const {
+        return group_rows.size();
+    }
+
+    // Returns the group ID of the row's key, adding a new group if the key has not been inserted before.
+    // equal(a, b) compares the keys of rows a and b
+    template<class Equal>
+    int64_t Insert(int64_t row, uint64_t hash, int64_t count, Equal equal) {
+        // Grow at 50% load to keep probe sequences short
+        if (2 * (group_rows.size() + 1) > _slots.size()) {
+            Rehash(_slots.size() * 2);
+        }
+
+        size_t mask = _slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            auto group = _slots[slot];
+            if (group < 0) {
+                group = group_rows.size();
+                _slots[slot] = group;
+                group_rows.push_back(row);
+                group_sizes.push_back(count);
+                group_hashes.push_back(hash);
+                return group;
+            }
+            if (group_hashes[group] == hash && equal(group_rows[group], row)) {
+                group_sizes[group] += count;
+                return group;
+            }
+        }
+    }
+
+    // Returns the group ID of the key with the given hash for which match(group_row) is true, or -1 if there is none
+    template<class Match>
+    int64_t Find(uint64_t hash, Match match) const {
+        size_t mask = _slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            auto group = _slots[slot];
+            if (group < 0) {
+                return -1;
+            }
+            if (group_hashes[group] == hash && match(group_rows[group])) {
+                return group;
+            }
+        }
+    }
+
+protected:
+    void Rehash(size_t num_slots) {
+        _slots.assign(num_slots, -1);
+        size_t mask = num_slots - 1;
+        for (size_t group = 0; group < group_hashes.size(); group++) {
+            size_t slot = group_hashes[group] & mask;
+            while (_slots[slot] >= 0) {
+                slot = (slot + 1) & mask;
+            }
+            _slots[slot] = group;
+        }
+    }
+
+    std::vector<int64_t> _slots;
+};
+
+}
+
+#endif //VOTABLE_TEST__GROUPHASHTABLE_TCC_
@@ -0,0 +1,35 @@
+#include "GroupedView.h"
+
+namespace carta {
+
+GroupedView::GroupedView(const Column* key_column, const IndexList& subset_indices, bool is_subset) :
+    _is_subset(is_subset),
+    _key_column(key_column) {
+    if (is_subset) {
+        _subset_indices = subset_indices;
+    }
+    _valid = key_column && key_column->data_type != UNKNOWN_TYPE &&
+        key_column->GroupIndices(_subset_indices, _is_subset, _group_ids, _group_rows, _group_sizes);
+}
+
+bool GroupedView::IsValid() const {
+    return _valid;
+}
+
+size_t GroupedView::NumGroups() const {
+    return _group_rows.size();
+}
+
+const IndexList& GroupedView::GroupSizes() const {
+    return _group_sizes;
+}
+
+bool GroupedView::Aggregate(const Column* column, std::vector<ColumnStatistics>& stats) const {
+    // The column must belong to the same table as the key column
+    if (!_valid || !column || column->NumEntries() != _key_column->NumEntries()) {
+        return false;
+    }
+    return column->AggregateGroups(_subset_indices, _is_subset, _group_ids, _group_rows.size(), stats);
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef VOTABLE_TEST__GROUPEDVIEW_H_
+#define VOTABLE_TEST__GROUPEDVIEW_H_
+
+#include "Columns.h"
+
+namespace carta {
+
+// Rows of a table view grouped by the distinct entries of a key column. Groups are ordered by key, with NaN keys last
+class GroupedView {
+public:
+    GroupedView(const Column* key_column, const IndexList& subset_indices, bool is_subset);
+
+    bool IsValid() const;
+    size_t NumGroups() const;
+    // Number of rows in each group
+    const IndexList& GroupSizes() const;
+    // Key of each group
+    template<class T>
+    std::vector<T> Keys() const;
+    // Computes statistics of the column's entries in each group
+    bool Aggregate(const Column* column, std::vector<ColumnStatistics>& stats) const;
+
+protected:
+    bool _valid;
+    bool _is_subset;
+    IndexList _subset_indices;
+    const Column* _key_column;
+    // Group of each row of the view, and the first row and number of rows of each group
+    IndexList _group_ids;
+    IndexList _group_rows;
+    IndexList _group_sizes;
+};
+}
+
+#include "GroupedView.tcc"
+
+#endif //VOTABLE_TEST__GROUPEDVIEW_H_
@@ -0,0 +1,23 @@
+#ifndef VOTABLE_TEST__GROUPEDVIEW_TCC_
+#define VOTABLE_TEST__GROUPEDVIEW_TCC_
+
+namespace carta {
+
+template<class T>
+std::vector<T> GroupedView::Keys() const {
+    auto data_column = DataColumn<T>::TryCast(_key_column);
+    if (!_valid || !data_column) {
+        return std::vector<T>();
+    }
+
+    std::vector<T> keys;
+    keys.reserve(_group_rows.size());
+    for (auto row: _group_rows) {
+        keys.push_back(data_column->Entry(row));
+    }
+    return keys;
+}
+
+}
+
+#endif // VOTABLE_TEST__GROUPEDVIEW_TCC_
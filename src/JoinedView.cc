@@ -0,0 +1,264 @@
+#include "JoinedView.h"
+#include "GroupHashTable.tcc"
+#include "RadixSort.tcc"
+#include "Table.h"
+
+#include <functional>
+#include <string_view>
+
+namespace carta {
+
+using namespace std;
+
+static uint64_t KeyHash(int64_t key) {
+    return MixHash(key);
+}
+
+static uint64_t KeyHash(string_view key) {
+    return MixHash(hash<string_view>()(key));
+}
+
+// Keys of the rows of a view, in view order. String keys refer to the column's entries rather than copying them
+static void GatherKeys(const TableView& view, const Column* column, vector<int64_t>& keys) {
+    keys = view.ValuesAs<int64_t>(column);
+}
+
+static void GatherKeys(const Column* column, const IndexList& indices, bool is_subset, vector<string_view>& keys) {
+    auto& entries = DataColumn<string>::TryCast(column)->entries;
+    int64_t num_keys = is_subset ? indices.size() : entries.size();
+    keys.resize(num_keys);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_keys; i++) {
+        keys[i] = entries[is_subset ? indices[i] : i];
+    }
+}
+
+// Joins the positions of two lists of keys. The right keys are partitioned by the high bits of their hashes, and a hash table
+// is built for each partition in parallel. The left keys are then probed in parallel blocks, keeping the order of the left
+// keys and, for equal keys, of the right keys
+template<class K>
+static void HashJoin(const vector<K>& left_keys, const vector<K>& right_keys, JoinType join_type, IndexList& left_positions,
+    IndexList& right_positions) {
+    constexpr size_t num_partitions = size_t(1) << JOIN_PARTITION_BITS;
+    constexpr int partition_shift = 64 - JOIN_PARTITION_BITS;
+    int64_t num_right = right_keys.size();
+    int64_t num_left = left_keys.size();
+
+    vector<uint64_t> right_hashes(num_right);
+    IndexList partitioned_positions(num_right);
+    vector<int64_t> partition_offsets(num_partitions + 1, 0);
+    vector<vector<int64_t>> thread_counts(MaxThreadCount());
+#pragma omp parallel
+    {
+        int thread_index = ThreadIndex();
+        int num_threads = ThreadCount();
+        int64_t chunk_start = num_right * thread_index / num_threads;
+        int64_t chunk_end = num_right * (thread_index + 1) / num_threads;
+        auto& counts = thread_counts[thread_index];
+        counts.assign(num_partitions, 0);
+        for (auto i = chunk_start; i < chunk_end; i++) {
+            right_hashes[i] = KeyHash(right_keys[i]);
+            counts[right_hashes[i] >> partition_shift]++;
+        }
+
+#pragma omp barrier
+#pragma omp single
+        {
+            // Offsets are ordered by partition and then by thread, so that each partition lists its positions in ascending order
+            int64_t offset = 0;
+            for (size_t partition = 0; partition < num_partitions; partition++) {
+                partition_offsets[partition] = offset;
+                for (int t = 0; t < num_threads; t++) {
+                    auto count = thread_counts[t][partition];
+                    thread_counts[t][partition] = offset;
+                    offset += count;
+                }
+            }
+            partition_offsets[num_partitions] = offset;
+        }
+
+        for (auto i = chunk_start; i < chunk_end; i++) {
+            partitioned_positions[counts[right_hashes[i] >> partition_shift]++] = i;
+        }
+    }
+
+    // Within each partition, positions are regrouped so that the positions of each key are contiguous and ascending
+    vector<GroupHashTable> tables(num_partitions);
+    vector<IndexList> group_offsets(num_partitions);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t partition = 0; partition < num_partitions; partition++) {
+        auto begin = partition_offsets[partition];
+        auto end = partition_offsets[partition + 1];
+        auto& table = tables[partition];
+        IndexList groups(end - begin);
+        for (auto i = begin; i < end; i++) {
+            auto position = partitioned_positions[i];
+            groups[i - begin] = table.Insert(position, right_hashes[position], 1, [&](int64_t a, int64_t b) {
+                return right_keys[a] == right_keys[b];
+            });
+        }
+
+        auto& offsets = group_offsets[partition];
+        offsets.resize(table.NumGroups() + 1);
+        offsets[0] = begin;
+        for (size_t group = 0; group < table.NumGroups(); group++) {
+            offsets[group + 1] = offsets[group] + table.group_sizes[group];
+        }
+        IndexList next_offsets(offsets.begin(), offsets.end() - 1);
+        IndexList grouped_positions(end - begin);
+        for (auto i = begin; i < end; i++) {
+            grouped_positions[next_offsets[groups[i - begin]]++ - begin] = partitioned_positions[i];
+        }
+        copy(grouped_positions.begin(), grouped_positions.end(), partitioned_positions.begin() + begin);
+    }
+    vector<uint64_t>().swap(right_hashes);
+
+    int64_t num_blocks = (num_left + JOIN_BLOCK_SIZE - 1) / JOIN_BLOCK_SIZE;
+    vector<IndexList> block_left(num_blocks);
+    vector<IndexList> block_right(num_blocks);
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t block = 0; block < num_blocks; block++) {
+        int64_t block_end = min((block + 1) * JOIN_BLOCK_SIZE, num_left);
+        auto& left = block_left[block];
+        auto& right = block_right[block];
+        for (int64_t i = block * JOIN_BLOCK_SIZE; i < block_end; i++) {
+            auto& key = left_keys[i];
+            auto key_hash = KeyHash(key);
+            auto partition = key_hash >> partition_shift;
+            auto group = tables[partition].Find(key_hash, [&](int64_t position) {
+                return right_keys[position] == key;
+            });
+            if (group >= 0) {
+                auto& offsets = group_offsets[partition];
+                for (auto j = offsets[group]; j < offsets[group + 1]; j++) {
+                    left.push_back(i);
+                    right.push_back(partitioned_positions[j]);
+                }
+            } else if (join_type == LEFT_JOIN) {
+                left.push_back(i);
+                right.push_back(-1);
+            }
+        }
+    }
+
+    size_t num_pairs = 0;
+    for (auto& left: block_left) {
+        num_pairs += left.size();
+    }
+    left_positions.clear();
+    right_positions.clear();
+    left_positions.reserve(num_pairs);
+    right_positions.reserve(num_pairs);
+    for (int64_t block = 0; block < num_blocks; block++) {
+        left_positions.insert(left_positions.end(), block_left[block].begin(), block_left[block].end());
+        right_positions.insert(right_positions.end(), block_right[block].begin(), block_right[block].end());
+    }
+}
+
+JoinedView::JoinedView(const TableView& left_view, const Column* left_key, const TableView& right_view, const Column* right_key,
+    JoinType join_type) :
+    _valid(false),
+    _left_view(left_view._table, IndexList(), false),
+    _right_view(right_view._table, IndexList(), false) {
+    auto integer = [](const Column* column) {
+        return column && column->data_type >= UINT8 && column->data_type <= INT64;
+    };
+    auto string_key = [](const Column* column) {
+        return column && column->data_type == STRING;
+    };
+    auto signed_integer = [](const Column* column) {
+        auto type = column->data_type;
+        return type == INT8 || type == INT16 || type == INT32 || type == INT64;
+    };
+    // Keys must be columns of the tables they are joined from
+    if (!left_key || left_key->NumEntries() != left_view._table.NumRows() || !right_key ||
+        right_key->NumEntries() != right_view._table.NumRows()) {
+        return;
+    }
+    // Integer keys are compared as int64, which would match unsigned 64-bit entries above INT64_MAX to negative entries
+    if ((left_key->data_type == UINT64 && signed_integer(right_key)) || (right_key->data_type == UINT64 && signed_integer(left_key))) {
+        return;
+    }
+
+    IndexList left_positions, right_positions;
+    if (integer(left_key) && integer(right_key)) {
+        vector<int64_t> left_keys, right_keys;
+        GatherKeys(left_view, left_key, left_keys);
+        GatherKeys(right_view, right_key, right_keys);
+        HashJoin(left_keys, right_keys, join_type, left_positions, right_positions);
+    } else if (string_key(left_key) && string_key(right_key)) {
+        vector<string_view> left_keys, right_keys;
+        GatherKeys(left_key, left_view._subset_indices, left_view._is_subset, left_keys);
+        GatherKeys(right_key, right_view._subset_indices, right_view._is_subset, right_keys);
+        HashJoin(left_keys, right_keys, join_type, left_positions, right_positions);
+    } else {
+        return;
+    }
+
+    int64_t num_pairs = left_positions.size();
+    if (join_type == LEFT_JOIN) {
+        for (int64_t i = 0; i < num_pairs; i++) {
+            if (right_positions[i] < 0) {
+                _unmatched.push_back(i);
+            }
+        }
+    }
+
+    // Positions in each view are converted to table rows in place
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_pairs; i++) {
+        if (left_view._is_subset) {
+            left_positions[i] = left_view._subset_indices[left_positions[i]];
+        }
+        auto right_position = right_positions[i];
+        if (right_position < 0) {
+            right_positions[i] = 0;
+        } else if (right_view._is_subset) {
+            right_positions[i] = right_view._subset_indices[right_position];
+        }
+    }
+    _left_view._subset_indices.swap(left_positions);
+    _right_view._subset_indices.swap(right_positions);
+    _valid = true;
+}
+
+bool JoinedView::IsValid() const {
+    return _valid;
+}
+
+size_t JoinedView::NumRows() const {
+    return _left_view._subset_indices.size();
+}
+
+const IndexList& JoinedView::LeftRows() const {
+    return _left_view._subset_indices;
+}
+
+IndexList JoinedView::RightRows() const {
+    IndexList rows = _right_view._subset_indices;
+    for (auto position: _unmatched) {
+        rows[position] = -1;
+    }
+    return rows;
+}
+
+const TableView* JoinedView::ColumnView(const Column* column) const {
+    if (!_valid || !column) {
+        return nullptr;
+    }
+    for (auto view: {&_left_view, &_right_view}) {
+        auto& table = view->_table;
+        for (size_t i = 0; i < table.NumColumns(); i++) {
+            if (table[i] == column) {
+                return view;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void JoinedView::ClampRange(int64_t& start, int64_t& end) const {
+    _left_view.ClampRange(start, end);
+}
+
+}
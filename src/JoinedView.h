@@ -0,0 +1,69 @@
+#ifndef VOTABLE_TEST__JOINEDVIEW_H_
+#define VOTABLE_TEST__JOINEDVIEW_H_
+
+#include <cmath>
+#include <type_traits>
+
+#include "Columns.h"
+#include "TableView.h"
+
+// Number of bits of a key's hash used to assign it to one of the partitions of a hash join
+#define JOIN_PARTITION_BITS 8
+// Number of rows of the left view probed together by each thread during a hash join
+#define JOIN_BLOCK_SIZE 4096
+
+namespace carta {
+
+// Entry used in place of the right table's entries for unmatched rows of a left join
+template<class T>
+T MissingValue() {
+    if constexpr (std::is_floating_point_v<T>) {
+        return NAN;
+    } else {
+        return T();
+    }
+}
+
+// Pairs of rows of two table views with equal entries in integer or string key columns, ordered by the left view and then
+// by the right view. Rows of the left view without a match are paired with row -1 in a left join. Entries of the joined
+// columns are gathered on demand rather than copied. Unsigned 64-bit keys cannot be joined with signed keys. In a join of
+// a table with itself, columns always refer to the left view, and the rows of the right view are given by RightRows
+class JoinedView {
+public:
+    JoinedView(const TableView& left_view, const Column* left_key, const TableView& right_view, const Column* right_key,
+        JoinType join_type = INNER_JOIN);
+
+    bool IsValid() const;
+    size_t NumRows() const;
+    // Rows of each table in each row of the join
+    const IndexList& LeftRows() const;
+    IndexList RightRows() const;
+    // Entries of a column of either table for rows [start, end) of the join, using the missing entry for unmatched rows.
+    // If both views are of the same table, the column is taken from the left view
+    template<class T>
+    std::vector<T> Values(const Column* column, int64_t start = -1, int64_t end = -1, T missing = MissingValue<T>()) const;
+    // As Values, but converting the entries of any numeric column, and copying them into a caller-provided buffer.
+    // Returns the number of entries copied
+    template<class OutT>
+    size_t FillValuesAs(const Column* column, OutT* buffer, int64_t start = -1, int64_t end = -1, OutT missing = MissingValue<OutT>()) const;
+
+protected:
+    // View containing the column, or nullptr if neither table contains it
+    const TableView* ColumnView(const Column* column) const;
+    void ClampRange(int64_t& start, int64_t& end) const;
+    // Overwrites the entries of unmatched rows in [start, end), with the buffer holding rows from start onwards
+    template<class T>
+    void FillMissing(T* buffer, int64_t start, int64_t end, const T& missing) const;
+
+    bool _valid;
+    // Views of the rows of each table in the order of the join. Unmatched rows are stored as row 0 of the right table, and
+    // their positions in the join are listed in ascending order
+    TableView _left_view;
+    TableView _right_view;
+    IndexList _unmatched;
+};
+}
+
+#include "JoinedView.tcc"
+
+#endif //VOTABLE_TEST__JOINEDVIEW_H_
@@ -0,0 +1,62 @@
+#ifndef VOTABLE_TEST__JOINEDVIEW_TCC_
+#define VOTABLE_TEST__JOINEDVIEW_TCC_
+
+#include <algorithm>
+
+namespace carta {
+
+template<class T>
+std::vector<T> JoinedView::Values(const Column* column, int64_t start, int64_t end, T missing) const {
+    auto view = ColumnView(column);
+    if (!view || !DataColumn<T>::TryCast(column)) {
+        return std::vector<T>();
+    }
+
+    ClampRange(start, end);
+    std::vector<T> values;
+    if (view == &_right_view && _unmatched.size() == NumRows()) {
+        values.assign(end - start, missing);
+        return values;
+    }
+    values = view->Values<T>(column, start, end);
+    if (view == &_right_view) {
+        FillMissing(values.data(), start, start + values.size(), missing);
+    }
+    return values;
+}
+
+template<class OutT>
+size_t JoinedView::FillValuesAs(const Column* column, OutT* buffer, int64_t start, int64_t end, OutT missing) const {
+    auto view = ColumnView(column);
+    if (!view || !buffer) {
+        return 0;
+    }
+
+    ClampRange(start, end);
+    // When no rows are matched, there is nothing to gather, and the right table may have no rows to gather from
+    if (view == &_right_view && _unmatched.size() == NumRows()) {
+        if (!TableView::IsNumeric(column)) {
+            return 0;
+        }
+        std::fill(buffer, buffer + end - start, missing);
+        return end - start;
+    }
+    size_t num_values = view->FillValuesAs(column, buffer, start, end);
+    if (view == &_right_view) {
+        FillMissing(buffer, start, start + num_values, missing);
+    }
+    return num_values;
+}
+
+template<class T>
+void JoinedView::FillMissing(T* buffer, int64_t start, int64_t end, const T& missing) const {
+    auto first = std::lower_bound(_unmatched.begin(), _unmatched.end(), start);
+    auto last = std::lower_bound(first, _unmatched.end(), end);
+    for (auto it = first; it != last; ++it) {
+        buffer[*it - start] = missing;
+    }
+}
+
+}
+
+#endif // VOTABLE_TEST__JOINEDVIEW_TCC_
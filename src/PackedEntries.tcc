@@ -0,0 +1,288 @@
+#ifndef VOTABLE_TEST__PACKEDENTRIES_TCC_
+#define VOTABLE_TEST__PACKEDENTRIES_TCC_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Number of entries sharing a frame of reference and an encoding in packed entries
+#define PACKED_BLOCK_SIZE int64_t(4096)
+// Entries are only packed if the packed form takes at most this fraction of the memory of the plain entries
+#define PACKED_MAX_SIZE_RATIO 0.75
+
+namespace carta {
+
+// Integer entries packed in blocks of PACKED_BLOCK_SIZE. Each block is stored either as offsets from the block minimum,
+// bit-packed with the width of the block's range (frame-of-reference encoding), or as runs of equal entries, whichever
+// is smaller. Blocks of a single repeated entry only take the space of their header
+template<class T>
+class PackedEntries {
+public:
+    static constexpr bool packable = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+    // Packs the entries, returning false and leaving the packed entries empty if packing would not save enough memory
+    bool Pack(const T* entries, int64_t num_entries) {
+        Clear();
+        int64_t num_blocks = (num_entries + PACKED_BLOCK_SIZE - 1) / PACKED_BLOCK_SIZE;
+        if (!num_entries) {
+            return false;
+        }
+
+        // Each block is measured first, so that the encoded blocks can be written in parallel to their final offsets
+        std::vector<Block> blocks(num_blocks);
+#pragma omp parallel for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * PACKED_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + PACKED_BLOCK_SIZE, num_entries);
+            T min_val = entries[block_start];
+            T max_val = entries[block_start];
+            int64_t num_runs = 1;
+            for (auto i = block_start + 1; i < block_end; i++) {
+                min_val = std::min(min_val, entries[i]);
+                max_val = std::max(max_val, entries[i]);
+                num_runs += entries[i] != entries[i - 1];
+            }
+
+            auto& stats = blocks[block];
+            stats.min = min_val;
+            stats.max = max_val;
+            stats.num_runs = num_runs;
+            stats.bit_width = BitWidth(Code(max_val, min_val));
+            size_t packed_size = NumWords(block_end - block_start, stats.bit_width) * sizeof(uint64_t);
+            size_t run_size = num_runs * (sizeof(T) + sizeof(uint16_t));
+            stats.encoding = run_size < packed_size ? RUN_LENGTH : BIT_PACKED;
+        }
+
+        int64_t num_words = 0;
+        int64_t num_runs = 0;
+        for (int64_t block = 0; block < num_blocks; block++) {
+            auto& stats = blocks[block];
+            if (stats.encoding == RUN_LENGTH) {
+                stats.offset = num_runs;
+                num_runs += stats.num_runs;
+            } else {
+                stats.offset = num_words;
+                num_words += NumWords(std::min(PACKED_BLOCK_SIZE, num_entries - block * PACKED_BLOCK_SIZE), stats.bit_width);
+            }
+        }
+        size_t packed_size = num_blocks * sizeof(Block) + num_words * sizeof(uint64_t) + num_runs * (sizeof(T) + sizeof(uint16_t));
+        if (packed_size > PACKED_MAX_SIZE_RATIO * num_entries * sizeof(T)) {
+            return false;
+        }
+
+        // Padding words allow every code to be read with two word loads
+        _words.assign(num_words + 2, 0);
+        _run_values.resize(num_runs);
+        _run_ends.resize(num_runs);
+#pragma omp parallel for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * PACKED_BLOCK_SIZE;
+            int64_t block_size = std::min(PACKED_BLOCK_SIZE, num_entries - block_start);
+            auto& stats = blocks[block];
+            if (stats.encoding == RUN_LENGTH) {
+                int64_t run = stats.offset;
+                for (int64_t i = 0; i < block_size; i++) {
+                    if (i && entries[block_start + i] != entries[block_start + i - 1]) {
+                        run++;
+                    }
+                    _run_values[run] = entries[block_start + i];
+                    _run_ends[run] = i + 1;
+                }
+            } else if (stats.bit_width) {
+                // Blocks start on word boundaries, so no two threads write to the same word
+                auto words = _words.data() + stats.offset;
+                int bit_width = stats.bit_width;
+                for (int64_t i = 0; i < block_size; i++) {
+                    uint64_t code = Code(entries[block_start + i], stats.min);
+                    uint64_t bit = uint64_t(i) * bit_width;
+                    int shift = bit & 63;
+                    words[bit >> 6] |= code << shift;
+                    if (shift + bit_width > 64) {
+                        words[(bit >> 6) + 1] |= code >> (64 - shift);
+                    }
+                }
+            }
+        }
+
+        _blocks.swap(blocks);
+        _num_entries = num_entries;
+        return true;
+    }
+
+    void Clear() {
+        _num_entries = 0;
+        std::vector<Block>().swap(_blocks);
+        std::vector<uint64_t>().swap(_words);
+        std::vector<T>().swap(_run_values);
+        std::vector<uint16_t>().swap(_run_ends);
+    }
+
+    bool Empty() const {
+        return _blocks.empty();
+    }
+
+    int64_t NumEntries() const {
+        return _num_entries;
+    }
+
+    size_t MemorySize() const {
+        return _blocks.capacity() * sizeof(Block) + _words.capacity() * sizeof(uint64_t) + _run_values.capacity() * sizeof(T) +
+            _run_ends.capacity() * sizeof(uint16_t);
+    }
+
+    T Get(int64_t i) const {
+        auto& block = _blocks[i / PACKED_BLOCK_SIZE];
+        int64_t position = i % PACKED_BLOCK_SIZE;
+        if (block.encoding == RUN_LENGTH) {
+            auto ends = _run_ends.data() + block.offset;
+            return _run_values[block.offset + (std::upper_bound(ends, ends + block.num_runs, position) - ends)];
+        }
+        return Value(Extract(_words.data() + block.offset, block.bit_width, Mask(block.bit_width), position), block.min);
+    }
+
+    // Decodes entries [start, end) to the output
+    void Unpack(int64_t start, int64_t end, T* output) const {
+        end = std::min(end, _num_entries);
+        while (start < end) {
+            int64_t block_start = start / PACKED_BLOCK_SIZE * PACKED_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + PACKED_BLOCK_SIZE, end);
+            auto& block = _blocks[start / PACKED_BLOCK_SIZE];
+            if (block.encoding == RUN_LENGTH) {
+                auto ends = _run_ends.data() + block.offset;
+                int64_t run = std::upper_bound(ends, ends + block.num_runs, start - block_start) - ends;
+                for (auto i = start; i < block_end; run++) {
+                    int64_t run_end = std::min(block_start + ends[run], block_end);
+                    std::fill(output + (i - start), output + (run_end - start), _run_values[block.offset + run]);
+                    i = run_end;
+                }
+            } else {
+                auto words = _words.data() + block.offset;
+                int bit_width = block.bit_width;
+                uint64_t mask = Mask(bit_width);
+                T reference = block.min;
+                for (auto i = start; i < block_end; i++) {
+                    output[i - start] = Value(Extract(words, bit_width, mask, i - block_start), reference);
+                }
+            }
+            output += block_end - start;
+            start = block_end;
+        }
+    }
+
+    void Gather(const int64_t* rows, int64_t num_rows, T* output) const {
+        for (int64_t i = 0; i < num_rows; i++) {
+            output[i] = Get(rows[i]);
+        }
+    }
+
+    // Appends the rows with entries in [low, high], or outside it if invert is true, in ascending order. Blocks entirely
+    // inside or outside the range are decided from their minimum and maximum, and bit-packed blocks are compared as codes
+    void Filter(T low, T high, bool invert, std::vector<int64_t>& rows) const {
+        int64_t num_blocks = _blocks.size();
+        for (int64_t block = 0; block < num_blocks; block++) {
+            auto& stats = _blocks[block];
+            int64_t block_start = block * PACKED_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + PACKED_BLOCK_SIZE, _num_entries);
+            T clipped_low = std::max(low, stats.min);
+            T clipped_high = std::min(high, stats.max);
+            bool none_inside = clipped_low > clipped_high;
+            bool all_inside = low <= stats.min && high >= stats.max;
+            if (none_inside || all_inside) {
+                if (none_inside == invert) {
+                    for (auto i = block_start; i < block_end; i++) {
+                        rows.push_back(i);
+                    }
+                }
+                continue;
+            }
+
+            if (stats.encoding == RUN_LENGTH) {
+                int64_t run_start = block_start;
+                for (int64_t run = stats.offset; run < stats.offset + stats.num_runs; run++) {
+                    int64_t run_end = block_start + _run_ends[run];
+                    T val = _run_values[run];
+                    if ((val >= low && val <= high) != invert) {
+                        for (auto i = run_start; i < run_end; i++) {
+                            rows.push_back(i);
+                        }
+                    }
+                    run_start = run_end;
+                }
+            } else {
+                // Codes are offsets from the block minimum, so the range maps to a contiguous range of codes
+                auto words = _words.data() + stats.offset;
+                int bit_width = stats.bit_width;
+                uint64_t mask = Mask(bit_width);
+                uint64_t code_low = Code(clipped_low, stats.min);
+                uint64_t code_span = Code(clipped_high, stats.min) - code_low;
+                // Rows are written unconditionally and kept by advancing the count, avoiding unpredictable branches
+                size_t num_rows = rows.size();
+                rows.resize(num_rows + block_end - block_start);
+                auto output = rows.data();
+                for (auto i = block_start; i < block_end; i++) {
+                    output[num_rows] = i;
+                    num_rows += (Extract(words, bit_width, mask, i - block_start) - code_low <= code_span) != invert;
+                }
+                rows.resize(num_rows);
+            }
+        }
+    }
+
+protected:
+    enum Encoding : uint8_t {
+        BIT_PACKED,
+        RUN_LENGTH
+    };
+
+    struct Block {
+        T min;
+        T max;
+        Encoding encoding;
+        uint8_t bit_width;
+        // Offset of the block's first word if bit-packed, or of its first run otherwise
+        int64_t offset;
+        int64_t num_runs;
+    };
+
+    // Offsets from the block minimum are computed in 64-bit unsigned arithmetic, which is exact for every integer type
+    static uint64_t Code(T val, T reference) {
+        return uint64_t(val) - uint64_t(reference);
+    }
+
+    static T Value(uint64_t code, T reference) {
+        return T(uint64_t(reference) + code);
+    }
+
+    static int BitWidth(uint64_t max_code) {
+        return max_code ? 64 - __builtin_clzll(max_code) : 0;
+    }
+
+    static uint64_t Mask(int bit_width) {
+        return bit_width == 64 ? ~uint64_t(0) : (uint64_t(1) << bit_width) - 1;
+    }
+
+    static int64_t NumWords(int64_t num_entries, int bit_width) {
+        return (num_entries * bit_width + 63) / 64;
+    }
+
+    // Reads the code at a position within a bit-packed block. The second word is shifted in two steps, so that no shift
+    // is by 64 bits when the code starts on a word boundary
+    static uint64_t Extract(const uint64_t* words, int bit_width, uint64_t mask, int64_t position) {
+        uint64_t bit = uint64_t(position) * bit_width;
+        auto word = words + (bit >> 6);
+        int shift = bit & 63;
+        return ((word[0] >> shift) | ((word[1] << 1) << (63 - shift))) & mask;
+    }
+
+    int64_t _num_entries = 0;
+    std::vector<Block> _blocks;
+    std::vector<uint64_t> _words;
+    // Run-length blocks store each run's entry and its end position within the block
+    std::vector<T> _run_values;
+    std::vector<uint16_t> _run_ends;
+};
+
+}
+
+#endif //VOTABLE_TEST__PACKEDENTRIES_TCC_
@@ -0,0 +1,134 @@
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace carta {
+
+QuantileSketch::QuantileSketch(double compression) :
+    _compression(compression),
+    _count(0),
+    _min(std::numeric_limits<double>::infinity()),
+    _max(-std::numeric_limits<double>::infinity()) {
+}
+
+void QuantileSketch::Add(double val) {
+    if (std::isnan(val)) {
+        return;
+    }
+    _buffer.push_back({val, 1});
+    _count++;
+    _min = std::min(_min, val);
+    _max = std::max(_max, val);
+    if (_buffer.size() >= QUANTILE_SKETCH_BUFFER_FACTOR * _compression) {
+        Compress();
+    }
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+    _buffer.insert(_buffer.end(), other._centroids.begin(), other._centroids.end());
+    _buffer.insert(_buffer.end(), other._buffer.begin(), other._buffer.end());
+    _count += other._count;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    Compress();
+}
+
+void QuantileSketch::Compress() {
+    if (_buffer.empty()) {
+        return;
+    }
+
+    _buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+    std::sort(_buffer.begin(), _buffer.end(), [](const Centroid& a, const Centroid& b) {
+        return a.mean < b.mean;
+    });
+
+    // Scale function k1 from Dunning & Ertl (2019): each centroid may span at most one unit of k, which limits the size
+    // of centroids near the tails
+    double total_weight = 0;
+    for (auto& centroid: _buffer) {
+        total_weight += centroid.weight;
+    }
+    double normalizer = _compression / (2 * M_PI);
+    auto weight_limit = [&](double weight_so_far) {
+        double k = normalizer * std::asin(2 * weight_so_far / total_weight - 1) + 1;
+        return total_weight * (std::sin(std::min(k / normalizer, M_PI / 2)) + 1) / 2;
+    };
+
+    _centroids.clear();
+    auto current = _buffer.front();
+    double weight_so_far = 0;
+    double limit = weight_limit(weight_so_far);
+    for (size_t i = 1; i < _buffer.size(); i++) {
+        auto& next = _buffer[i];
+        if (weight_so_far + current.weight + next.weight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            _centroids.push_back(current);
+            weight_so_far += current.weight;
+            limit = weight_limit(weight_so_far);
+            current = next;
+        }
+    }
+    _centroids.push_back(current);
+    _buffer.clear();
+}
+
+double QuantileSketch::Quantile(double fraction) const {
+    if (!_buffer.empty()) {
+        auto compressed = *this;
+        compressed.Compress();
+        return compressed.Quantile(fraction);
+    }
+    if (_centroids.empty() || !(fraction >= 0 && fraction <= 1)) {
+        return NAN;
+    }
+    if (fraction == 0) {
+        return _min;
+    } else if (fraction == 1) {
+        return _max;
+    }
+
+    // Each centroid's weight is taken to be centred on its mean, and quantiles are interpolated between neighbouring
+    // centres. Beyond the outermost centres, quantiles are interpolated towards the minimum and maximum values
+    double target = fraction * _count;
+    auto& first = _centroids.front();
+    if (target < first.weight / 2) {
+        return _min + (first.mean - _min) * target / (first.weight / 2);
+    }
+
+    double centre = first.weight / 2;
+    for (size_t i = 1; i < _centroids.size(); i++) {
+        auto& previous = _centroids[i - 1];
+        auto& current = _centroids[i];
+        double next_centre = centre + (previous.weight + current.weight) / 2;
+        if (target < next_centre) {
+            return previous.mean + (current.mean - previous.mean) * (target - centre) / (next_centre - centre);
+        }
+        centre = next_centre;
+    }
+
+    auto& last = _centroids.back();
+    return last.mean + (_max - last.mean) * (target - centre) / (last.weight / 2);
+}
+
+int64_t QuantileSketch::Count() const {
+    return _count;
+}
+
+double QuantileSketch::Min() const {
+    return _min;
+}
+
+double QuantileSketch::Max() const {
+    return _max;
+}
+
+size_t QuantileSketch::MemorySize() const {
+    return (_centroids.capacity() + _buffer.capacity()) * sizeof(Centroid);
+}
+
+}
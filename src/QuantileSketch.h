@@ -0,0 +1,51 @@
+#ifndef VOTABLE_TEST__QUANTILESKETCH_H_
+#define VOTABLE_TEST__QUANTILESKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression of quantile sketches, which keep at most about this many centroids. Larger values give more accurate quantiles
+#define QUANTILE_SKETCH_COMPRESSION 200
+// Number of buffered values per unit of compression, before the buffer is merged into the centroids
+#define QUANTILE_SKETCH_BUFFER_FACTOR 5
+
+namespace carta {
+
+// Mergeable sketch of the distribution of a set of values, for computing approximate quantiles. This is a merging
+// t-digest: values are summarized by weighted centroids, which are smaller near the tails so that extreme quantiles
+// remain accurate
+class QuantileSketch {
+public:
+    QuantileSketch(double compression = QUANTILE_SKETCH_COMPRESSION);
+
+    void Add(double val);
+    void Merge(const QuantileSketch& other);
+    // Merges buffered values into the centroids
+    void Compress();
+
+    // Estimated value below which the given fraction of the values lies, or NaN if the sketch is empty
+    double Quantile(double fraction) const;
+    int64_t Count() const;
+    double Min() const;
+    double Max() const;
+    // Heap memory used by the sketch, in bytes
+    size_t MemorySize() const;
+
+protected:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    double _compression;
+    std::vector<Centroid> _centroids;
+    std::vector<Centroid> _buffer;
+    int64_t _count;
+    double _min;
+    double _max;
+};
+
+}
+
+#endif //VOTABLE_TEST__QUANTILESKETCH_H_
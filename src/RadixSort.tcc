@@ -0,0 +1,161 @@
+#ifndef VOTABLE_TEST__RADIXSORT_TCC_
+#define VOTABLE_TEST__RADIXSORT_TCC_
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Columns.h"
+
+// Index lists shorter than this are sorted with a comparison sort, as the radix sort passes have a fixed overhead
+#define RADIX_SORT_MIN_SIZE 1024
+// Number of key bits sorted in each radix sort pass
+#define RADIX_SORT_BITS 11
+
+namespace carta {
+
+inline int ThreadIndex() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int ThreadCount() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int MaxThreadCount() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Maps a value to an unsigned integer key, such that comparing keys gives the same order as comparing values.
+// Descending keys are inverted, and NaNs are mapped to the largest possible key so that they are always sorted last
+template<class T>
+auto SortKey(T val, bool ascending = true) {
+    if constexpr (std::is_same_v<T, bool>) {
+        uint8_t key = val;
+        return ascending ? key : uint8_t(~key);
+    } else if constexpr (std::is_integral_v<T>) {
+        using KeyType = std::make_unsigned_t<T>;
+        KeyType key = val;
+        if constexpr (std::is_signed_v<T>) {
+            // Flipping the sign bit orders negative values before positive values
+            key ^= KeyType(1) << (sizeof(T) * 8 - 1);
+        }
+        return ascending ? key : KeyType(~key);
+    } else {
+        using KeyType = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+        constexpr KeyType sign_bit = KeyType(1) << (sizeof(T) * 8 - 1);
+        if (std::isnan(val)) {
+            return ~KeyType(0);
+        }
+        KeyType key;
+        memcpy(&key, &val, sizeof(T));
+        // Negative values have all bits flipped to reverse their order, while positive values have only their sign bit flipped
+        key = (key & sign_bit) ? ~key : (key | sign_bit);
+        // Infinities map to keys strictly between the extremes, so inverting never produces the NaN key
+        return ascending ? key : KeyType(~key);
+    }
+}
+
+// Stable parallel LSD radix sort of (key, index) pairs, using digits of RADIX_SORT_BITS bits. Passes over digits that are
+// identical for every key are skipped
+template<class K>
+void RadixSortPairs(K* keys, int64_t* indices, size_t num_items) {
+    if (num_items < 2) {
+        return;
+    }
+
+    std::vector<K> key_buffer(num_items);
+    IndexList index_buffer(num_items);
+    K* source_keys = keys;
+    int64_t* source_indices = indices;
+    K* destination_keys = key_buffer.data();
+    int64_t* destination_indices = index_buffer.data();
+
+    constexpr size_t num_digits = size_t(1) << RADIX_SORT_BITS;
+    constexpr size_t digit_mask = num_digits - 1;
+    constexpr size_t num_passes = (sizeof(K) * 8 + RADIX_SORT_BITS - 1) / RADIX_SORT_BITS;
+    std::vector<std::array<size_t, num_digits>> histograms(MaxThreadCount());
+    bool skip_pass = false;
+
+#pragma omp parallel default(none) shared(histograms, skip_pass, source_keys, source_indices, destination_keys, destination_indices, num_items)
+    {
+        int thread_index = ThreadIndex();
+        int num_threads = ThreadCount();
+        size_t chunk_start = num_items * thread_index / num_threads;
+        size_t chunk_end = num_items * (thread_index + 1) / num_threads;
+
+        for (size_t pass = 0; pass < num_passes; pass++) {
+            int shift = pass * RADIX_SORT_BITS;
+
+            // Each thread counts the digits of its own chunk
+            auto& histogram = histograms[thread_index];
+            histogram.fill(0);
+            for (auto i = chunk_start; i < chunk_end; i++) {
+                histogram[(source_keys[i] >> shift) & digit_mask]++;
+            }
+
+#pragma omp barrier
+#pragma omp single
+            {
+                // Convert counts to per-thread starting offsets, ordered by digit and then by thread to keep the sort stable
+                skip_pass = false;
+                size_t offset = 0;
+                for (size_t digit = 0; digit < num_digits; digit++) {
+                    size_t digit_count = 0;
+                    for (int t = 0; t < num_threads; t++) {
+                        auto count = histograms[t][digit];
+                        histograms[t][digit] = offset;
+                        offset += count;
+                        digit_count += count;
+                    }
+                    if (digit_count == num_items) {
+                        skip_pass = true;
+                    }
+                }
+            }
+
+            if (!skip_pass) {
+                for (auto i = chunk_start; i < chunk_end; i++) {
+                    auto key = source_keys[i];
+                    auto destination = histogram[(key >> shift) & digit_mask]++;
+                    destination_keys[destination] = key;
+                    destination_indices[destination] = source_indices[i];
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    std::swap(source_keys, destination_keys);
+                    std::swap(source_indices, destination_indices);
+                }
+            }
+        }
+    }
+
+    // After an odd number of passes, the sorted pairs are in the buffers rather than the original arrays
+    if (source_keys != keys) {
+        memcpy(keys, source_keys, num_items * sizeof(K));
+        memcpy(indices, source_indices, num_items * sizeof(int64_t));
+    }
+}
+
+}
+
+#endif //VOTABLE_TEST__RADIXSORT_TCC_
@@ -0,0 +1,29 @@
+#ifndef VOTABLE_TEST__SPAN_H_
+#define VOTABLE_TEST__SPAN_H_
+
+#include <cstddef>
+
+namespace carta {
+
+// Non-owning view of a contiguous range of values, in place of C++20's std::span
+template<class T>
+class Span {
+public:
+    Span() : _data(nullptr), _size(0) {}
+    Span(T* data, size_t size) : _data(data), _size(size) {}
+
+    T* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    T& operator[](size_t i) const { return _data[i]; }
+    T* begin() const { return _data; }
+    T* end() const { return _data + _size; }
+
+protected:
+    T* _data;
+    size_t _size;
+};
+
+}
+
+#endif //VOTABLE_TEST__SPAN_H_
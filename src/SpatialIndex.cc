@@ -0,0 +1,401 @@
+#include "SpatialIndex.h"
+#include "Geometry.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace carta {
+
+SpatialIndex::SpatialIndex(const std::vector<double>& ra, const std::vector<double>& dec) {
+    int64_t num_rows = std::min(ra.size(), dec.size());
+    _points.resize(num_rows);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_rows; i++) {
+        auto& point = _points[i];
+        if (std::isfinite(ra[i]) && std::isfinite(dec[i])) {
+            UnitVector(ra[i], dec[i], point.position);
+            point.row = i;
+        } else {
+            point.row = -1;
+        }
+    }
+    _points.erase(std::remove_if(_points.begin(), _points.end(), [](const Point& point) { return point.row < 0; }), _points.end());
+
+    // The tree is deep enough for each leaf to hold at most about KD_TREE_LEAF_SIZE points
+    int64_t num_points = _points.size();
+    _depth = 0;
+    while ((num_points >> _depth) > KD_TREE_LEAF_SIZE) {
+        _depth++;
+    }
+    _nodes.resize((size_t(2) << _depth) - 1);
+
+#pragma omp parallel
+#pragma omp single
+    Build(0, 0, num_points, 0);
+}
+
+size_t SpatialIndex::NumPoints() const {
+    return _points.size();
+}
+
+size_t SpatialIndex::MemorySize() const {
+    return _points.capacity() * sizeof(Point) + _nodes.capacity() * sizeof(Node);
+}
+
+void SpatialIndex::Build(size_t node_index, int64_t begin, int64_t end, int level) {
+    auto& node = _nodes[node_index];
+    node.begin = begin;
+    node.end = end;
+    for (int axis = 0; axis < 3; axis++) {
+        node.min[axis] = std::numeric_limits<double>::infinity();
+        node.max[axis] = -std::numeric_limits<double>::infinity();
+    }
+    for (auto i = begin; i < end; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            node.min[axis] = std::min(node.min[axis], _points[i].position[axis]);
+            node.max[axis] = std::max(node.max[axis], _points[i].position[axis]);
+        }
+    }
+    if (level == _depth) {
+        return;
+    }
+
+    // Split at the median along the axis with the largest extent
+    int split_axis = 0;
+    for (int axis = 1; axis < 3; axis++) {
+        if (node.max[axis] - node.min[axis] > node.max[split_axis] - node.min[split_axis]) {
+            split_axis = axis;
+        }
+    }
+    int64_t middle = (begin + end) / 2;
+    std::nth_element(_points.begin() + begin, _points.begin() + middle, _points.begin() + end, [&](const Point& a, const Point& b) {
+        return a.position[split_axis] < b.position[split_axis];
+    });
+
+    if (end - begin >= KD_TREE_TASK_MIN_SIZE) {
+#pragma omp task
+        Build(2 * node_index + 1, begin, middle, level + 1);
+#pragma omp task
+        Build(2 * node_index + 2, middle, end, level + 1);
+#pragma omp taskwait
+    } else {
+        Build(2 * node_index + 1, begin, middle, level + 1);
+        Build(2 * node_index + 2, middle, end, level + 1);
+    }
+}
+
+template<class Classify, class Contains>
+void SpatialIndex::Search(Classify classify, Contains contains, IndexList& rows) const {
+    rows.clear();
+    if (_points.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<size_t, int>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [node_index, level] = stack.back();
+        stack.pop_back();
+        auto& node = _nodes[node_index];
+        if (node.begin == node.end) {
+            continue;
+        }
+
+        auto overlap = classify(node);
+        if (overlap == NODE_INSIDE) {
+            for (auto i = node.begin; i < node.end; i++) {
+                rows.push_back(_points[i].row);
+            }
+        } else if (overlap == NODE_PARTIAL) {
+            if (level == _depth) {
+                for (auto i = node.begin; i < node.end; i++) {
+                    if (contains(_points[i].position)) {
+                        rows.push_back(_points[i].row);
+                    }
+                }
+            } else {
+                stack.push_back({2 * node_index + 1, level + 1});
+                stack.push_back({2 * node_index + 2, level + 1});
+            }
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+}
+
+SpatialIndex::NodeOverlap SpatialIndex::ConeOverlap(const Node& node, const double* centre, double radius_squared) {
+    // Uses the nearest and farthest points of the node's bounding box
+    double min_distance = 0;
+    double max_distance = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        double below = node.min[axis] - centre[axis];
+        double above = centre[axis] - node.max[axis];
+        double nearest = std::max({below, above, 0.0});
+        double farthest = std::max(std::abs(below), std::abs(above));
+        min_distance += nearest * nearest;
+        max_distance += farthest * farthest;
+    }
+    if (min_distance > radius_squared) {
+        return NODE_OUTSIDE;
+    }
+    return max_distance <= radius_squared ? NODE_INSIDE : NODE_PARTIAL;
+}
+
+double SpatialIndex::MinDistanceSquared(const Node& node, const double* centre) {
+    double distance = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        double nearest = std::max({node.min[axis] - centre[axis], centre[axis] - node.max[axis], 0.0});
+        distance += nearest * nearest;
+    }
+    return distance;
+}
+
+double SpatialIndex::ChordSquared(double angle) {
+    double chord = 2 * std::sin(std::min(angle, 180.0) * M_PI / 360.0);
+    return chord * chord;
+}
+
+double SpatialIndex::ChordAngle(double chord_squared) {
+    return 360.0 / M_PI * std::asin(std::min(std::sqrt(chord_squared) / 2, 1.0));
+}
+
+bool SpatialIndex::ConeSearch(double ra, double dec, double radius, IndexList& rows) const {
+    if (!(radius >= 0) || !std::isfinite(ra) || !std::isfinite(dec)) {
+        return false;
+    }
+
+    double centre[3];
+    UnitVector(ra, dec, centre);
+    double chord_squared = ChordSquared(radius);
+    Search([&](const Node& node) { return ConeOverlap(node, centre, chord_squared); }, [&](const double* position) {
+        double distance = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            distance += (position[axis] - centre[axis]) * (position[axis] - centre[axis]);
+        }
+        return distance <= chord_squared;
+    }, rows);
+    return true;
+}
+
+bool SpatialIndex::BoxSearch(double ra_min, double ra_max, double dec_min, double dec_max, IndexList& rows) const {
+    if (!(dec_min <= dec_max) || !std::isfinite(ra_min) || !std::isfinite(ra_max)) {
+        return false;
+    }
+
+    // Dec limits are a band of z, and RA limits a wedge bounded by two planes through the poles. Normals point into the
+    // wedge, so that points between the RA limits have non-negative distances from both planes
+    double z_min = std::sin(std::max(dec_min, -90.0) * M_PI / 180.0);
+    double z_max = std::sin(std::min(dec_max, 90.0) * M_PI / 180.0);
+    double ra_width = ra_max - ra_min;
+    bool full_circle = ra_width >= 360;
+    ra_width = std::fmod(std::fmod(ra_width, 360) + 360, 360);
+    bool convex = ra_width <= 180;
+    double start_normal[3] = {-std::sin(ra_min * M_PI / 180.0), std::cos(ra_min * M_PI / 180.0), 0};
+    double end_normal[3] = {std::sin(ra_max * M_PI / 180.0), -std::cos(ra_max * M_PI / 180.0), 0};
+
+    // Extremes of the distance from a plane over a bounding box
+    auto plane_range = [](const Node& node, const double* normal, double& min_distance, double& max_distance) {
+        min_distance = max_distance = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            min_distance += normal[axis] * (normal[axis] > 0 ? node.min[axis] : node.max[axis]);
+            max_distance += normal[axis] * (normal[axis] > 0 ? node.max[axis] : node.min[axis]);
+        }
+    };
+
+    auto classify = [&](const Node& node) {
+        if (node.max[2] < z_min || node.min[2] > z_max) {
+            return NODE_OUTSIDE;
+        }
+        bool inside = node.min[2] >= z_min && node.max[2] <= z_max;
+        if (!full_circle) {
+            double start_min, start_max, end_min, end_max;
+            plane_range(node, start_normal, start_min, start_max);
+            plane_range(node, end_normal, end_min, end_max);
+            if (convex) {
+                if (start_max < 0 || end_max < 0) {
+                    return NODE_OUTSIDE;
+                }
+                inside = inside && start_min >= 0 && end_min >= 0;
+            } else {
+                if (start_max < 0 && end_max < 0) {
+                    return NODE_OUTSIDE;
+                }
+                inside = inside && (start_min >= 0 || end_min >= 0);
+            }
+        }
+        return inside ? NODE_INSIDE : NODE_PARTIAL;
+    };
+
+    auto contains = [&](const double* position) {
+        if (position[2] < z_min || position[2] > z_max) {
+            return false;
+        }
+        if (full_circle) {
+            return true;
+        }
+        bool after_start = start_normal[0] * position[0] + start_normal[1] * position[1] >= 0;
+        bool before_end = end_normal[0] * position[0] + end_normal[1] * position[1] >= 0;
+        return convex ? (after_start && before_end) : (after_start || before_end);
+    };
+
+    Search(classify, contains, rows);
+    return true;
+}
+
+bool SpatialIndex::PolygonSearch(const std::vector<double>& ra, const std::vector<double>& dec, IndexList& rows) const {
+    size_t num_vertices = ra.size();
+    if (num_vertices < 3 || dec.size() != num_vertices) {
+        return false;
+    }
+
+    // The polygon is bounded by a cone around the mean of its vertices
+    std::vector<double> vertices(3 * num_vertices);
+    double centre[3] = {0, 0, 0};
+    for (size_t i = 0; i < num_vertices; i++) {
+        if (!std::isfinite(ra[i]) || !std::isfinite(dec[i])) {
+            return false;
+        }
+        UnitVector(ra[i], dec[i], &vertices[3 * i]);
+        for (int axis = 0; axis < 3; axis++) {
+            centre[axis] += vertices[3 * i + axis];
+        }
+    }
+    double norm = std::sqrt(centre[0] * centre[0] + centre[1] * centre[1] + centre[2] * centre[2]);
+    if (norm == 0) {
+        return false;
+    }
+    double radius_squared = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        centre[axis] /= norm;
+    }
+    for (size_t i = 0; i < num_vertices; i++) {
+        double* vertex = &vertices[3 * i];
+        if (vertex[0] * centre[0] + vertex[1] * centre[1] + vertex[2] * centre[2] <= 0) {
+            return false;
+        }
+        double distance = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            distance += (vertex[axis] - centre[axis]) * (vertex[axis] - centre[axis]);
+        }
+        radius_squared = std::max(radius_squared, distance);
+    }
+
+    // The gnomonic projection about the centre maps great circles to straight lines, so the polygon test is planar
+    double east[3] = {-centre[1], centre[0], 0};
+    double east_norm = std::hypot(east[0], east[1]);
+    if (east_norm < 1e-12) {
+        east[0] = 1;
+        east[1] = 0;
+    } else {
+        east[0] /= east_norm;
+        east[1] /= east_norm;
+    }
+    double north[3] = {centre[1] * east[2] - centre[2] * east[1], centre[2] * east[0] - centre[0] * east[2],
+        centre[0] * east[1] - centre[1] * east[0]};
+    auto project = [&](const double* position, double& x, double& y) {
+        double depth = position[0] * centre[0] + position[1] * centre[1] + position[2] * centre[2];
+        x = (position[0] * east[0] + position[1] * east[1] + position[2] * east[2]) / depth;
+        y = (position[0] * north[0] + position[1] * north[1] + position[2] * north[2]) / depth;
+        return depth > 0;
+    };
+    std::vector<double> polygon_x(num_vertices);
+    std::vector<double> polygon_y(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++) {
+        project(&vertices[3 * i], polygon_x[i], polygon_y[i]);
+    }
+
+    Search([&](const Node& node) {
+        // Nodes inside the bounding cone may still lie partly outside the polygon
+        return ConeOverlap(node, centre, radius_squared) == NODE_OUTSIDE ? NODE_OUTSIDE : NODE_PARTIAL;
+    }, [&](const double* position) {
+        double x, y;
+        return project(position, x, y) && PointInPolygon(x, y, polygon_x, polygon_y);
+    }, rows);
+    return true;
+}
+
+int64_t SpatialIndex::NearestNeighbour(double ra, double dec, double radius, double& separation) const {
+    separation = NAN;
+    if (_points.empty() || !(radius >= 0) || !std::isfinite(ra) || !std::isfinite(dec)) {
+        return -1;
+    }
+
+    double centre[3];
+    UnitVector(ra, dec, centre);
+    double best_distance = ChordSquared(radius);
+    int64_t best_row = -1;
+
+    // Depth-first search visiting the nearer child first, skipping nodes farther away than the best point so far
+    std::vector<std::pair<size_t, int>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [node_index, level] = stack.back();
+        stack.pop_back();
+        auto& node = _nodes[node_index];
+        if (node.begin == node.end || MinDistanceSquared(node, centre) > best_distance) {
+            continue;
+        }
+
+        if (level == _depth) {
+            for (auto i = node.begin; i < node.end; i++) {
+                auto& point = _points[i];
+                double distance = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    distance += (point.position[axis] - centre[axis]) * (point.position[axis] - centre[axis]);
+                }
+                if (distance < best_distance || (distance == best_distance && (best_row < 0 || point.row < best_row))) {
+                    best_distance = distance;
+                    best_row = point.row;
+                }
+            }
+        } else {
+            size_t left = 2 * node_index + 1;
+            size_t right = 2 * node_index + 2;
+            if (MinDistanceSquared(_nodes[left], centre) < MinDistanceSquared(_nodes[right], centre)) {
+                std::swap(left, right);
+            }
+            stack.push_back({left, level + 1});
+            stack.push_back({right, level + 1});
+        }
+    }
+
+    if (best_row >= 0) {
+        separation = ChordAngle(best_distance);
+    }
+    return best_row;
+}
+
+void SpatialIndex::Neighbours(double ra, double dec, double radius, IndexList& rows, std::vector<double>& separations) const {
+    if (_points.empty() || !(radius >= 0) || !std::isfinite(ra) || !std::isfinite(dec)) {
+        return;
+    }
+
+    double centre[3];
+    UnitVector(ra, dec, centre);
+    double chord_squared = ChordSquared(radius);
+    std::vector<std::pair<size_t, int>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [node_index, level] = stack.back();
+        stack.pop_back();
+        auto& node = _nodes[node_index];
+        if (node.begin == node.end || MinDistanceSquared(node, centre) > chord_squared) {
+            continue;
+        }
+
+        if (level == _depth) {
+            for (auto i = node.begin; i < node.end; i++) {
+                auto& point = _points[i];
+                double distance = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    distance += (point.position[axis] - centre[axis]) * (point.position[axis] - centre[axis]);
+                }
+                if (distance <= chord_squared) {
+                    rows.push_back(point.row);
+                    separations.push_back(ChordAngle(distance));
+                }
+            }
+        } else {
+            stack.push_back({2 * node_index + 1, level + 1});
+            stack.push_back({2 * node_index + 2, level + 1});
+        }
+    }
+}
+
+}
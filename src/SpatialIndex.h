@@ -0,0 +1,79 @@
+#ifndef VOTABLE_TEST__SPATIALINDEX_H_
+#define VOTABLE_TEST__SPATIALINDEX_H_
+
+#include <vector>
+
+#include "Columns.h"
+
+// Maximum number of points in each leaf of a spatial index
+#define KD_TREE_LEAF_SIZE 32
+// Subtrees with at least this many points are built as separate parallel tasks
+#define KD_TREE_TASK_MIN_SIZE (64 * 1024)
+
+namespace carta {
+
+// Spatial index of sky positions, as a balanced k-d tree over unit vectors. Working with unit vectors avoids any special
+// handling of RA wrap-around or the poles. Searches return rows in ascending order, and only test the rows in leaves that
+// overlap the search region
+class SpatialIndex {
+public:
+    // Indexes the rows with valid positions, given in degrees
+    SpatialIndex(const std::vector<double>& ra, const std::vector<double>& dec);
+
+    size_t NumPoints() const;
+    // Heap memory used by the index, in bytes
+    size_t MemorySize() const;
+    // Rows within the given angular radius of a position
+    bool ConeSearch(double ra, double dec, double radius, IndexList& rows) const;
+    // Rows within RA and Dec limits. The RA limits wrap around 360 degrees if ra_min is greater than ra_max
+    bool BoxSearch(double ra_min, double ra_max, double dec_min, double dec_max, IndexList& rows) const;
+    // Rows within a polygon with vertices joined by great circles. The polygon must lie within a hemisphere
+    bool PolygonSearch(const std::vector<double>& ra, const std::vector<double>& dec, IndexList& rows) const;
+    // Row of the nearest point within the given radius of a position, or -1 if there is none, with ties going to the lowest
+    // row. The separation is set in degrees
+    int64_t NearestNeighbour(double ra, double dec, double radius, double& separation) const;
+    // Appends the rows within the given radius of a position, and their separations in degrees, in no particular order
+    void Neighbours(double ra, double dec, double radius, IndexList& rows, std::vector<double>& separations) const;
+
+protected:
+    struct Point {
+        double position[3];
+        int64_t row;
+    };
+
+    // Nodes are stored as a complete binary tree, with the children of node i at 2i + 1 and 2i + 2
+    struct Node {
+        double min[3];
+        double max[3];
+        int64_t begin;
+        int64_t end;
+    };
+
+    enum NodeOverlap {
+        NODE_OUTSIDE,
+        NODE_PARTIAL,
+        NODE_INSIDE
+    };
+
+    void Build(size_t node_index, int64_t begin, int64_t end, int level);
+    // Overlap of a node with a sphere of the given squared radius
+    static NodeOverlap ConeOverlap(const Node& node, const double* centre, double radius_squared);
+    // Squared distance from a point to the nearest point of a node's bounding box
+    static double MinDistanceSquared(const Node& node, const double* centre);
+    // Angular distances are compared as squared chord lengths between unit vectors. Converts angles in degrees to squared
+    // chord lengths, and back
+    static double ChordSquared(double angle);
+    static double ChordAngle(double chord_squared);
+    // Collects the rows of points in nodes classified as inside, and of points passing the contains test in partially
+    // overlapping leaves
+    template<class Classify, class Contains>
+    void Search(Classify classify, Contains contains, IndexList& rows) const;
+
+    std::vector<Point> _points;
+    std::vector<Node> _nodes;
+    int _depth;
+};
+
+}
+
+#endif //VOTABLE_TEST__SPATIALINDEX_H_
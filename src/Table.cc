@@ -3,15 +3,23 @@
 #include <fmt/format.h>
 #include <filesystem>
 #include <fitsio.h>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tbb/parallel_sort.h>
 
 #include "Table.h"
 #include "DataColumn.tcc"
+#include "RadixSort.tcc"
 
 namespace carta {
 using namespace std;
 
-Table::Table(const string& filename, bool header_only)
-    : _filename(filename), _num_rows(0) {
+Table::Table(const string& filename, bool header_only, bool use_cache, const string& scratch_directory, size_t read_chunk_size)
+    : _valid(false), _filename(filename), _num_rows(0), _cached_memory_size(0) {
     filesystem::path file_path(filename);
 
     if (!filesystem::exists(file_path)) {
@@ -19,14 +27,38 @@ Table::Table(const string& filename, bool header_only)
         return;
     }
 
+    if (scratch_directory.empty()) {
+        // An arena maps at least one slab, which would be mostly unused by a small table
+        error_code size_error;
+        auto file_size = filesystem::file_size(file_path, size_error);
+        if (!size_error && file_size >= ARENA_MIN_FILE_SIZE) {
+            _storage = ColumnStorage::FromArena();
+        }
+    } else {
+        _storage = ColumnStorage::FromScratchDirectory(scratch_directory);
+        if (!_storage) {
+            fmt::print("Could not create a scratch file in {}\n", scratch_directory);
+            return;
+        }
+    }
+
+    if (use_cache && !header_only && ConstructFromCache()) {
+        _valid = true;
+        return;
+    }
+
     auto magic_number = GetMagicNumber(filename);
     if (magic_number == FITS_MAGIC_NUMBER) {
-        _valid = ConstructFromFITS(header_only);
+        _valid = ConstructFromFITS(header_only, read_chunk_size);
     } else if (magic_number == XML_MAGIC_NUMBER) {
         ConstructFromXML(header_only);
     } else {
 
     }
+
+    if (use_cache && !header_only && _valid) {
+        WriteCache();
+    }
 }
 
 uint32_t Table::GetMagicNumber(const string& filename) {
@@ -125,6 +157,7 @@ bool Table::PopulateFields(const pugi::xml_node& table) {
 
     for (auto& field: table.children("FIELD")) {
         auto& column = _columns.emplace_back(Column::FromField(field));
+        column->SetStorage(_storage);
         if (!column->name.empty()) {
             _column_name_map[column->name] = column.get();
         }
@@ -176,10 +209,15 @@ bool Table::PopulateRows(const pugi::xml_node& table) {
         }
     }
 
+    // Block statistics can only be computed once all rows have been filled
+    for (auto& column: _columns) {
+        column->ComputeBlockStatistics();
+    }
+
     return true;
 }
 
-bool Table::ConstructFromFITS(bool header_only) {
+bool Table::ConstructFromFITS(bool header_only, size_t read_chunk_size) {
     fitsfile* file_ptr = nullptr;
     int status = 0;
     // Attempt to open the first table HDU. status = 0 means no error
@@ -205,7 +243,8 @@ bool Table::ConstructFromFITS(bool header_only) {
     fits_read_key(file_ptr, TINT, "NAXIS1", &total_width, nullptr, &status);
     _num_rows = header_only ? 0 : rows;
 
-    if (num_cols <= 0) {
+    // Rows without a width cannot be read, and would leave the entries of the columns uninitialized
+    if (num_cols <= 0 || (_num_rows && total_width <= 0)) {
         fits_close_file(file_ptr, &status);
         return false;
     }
@@ -214,6 +253,7 @@ bool Table::ConstructFromFITS(bool header_only) {
     size_t col_offset = 0;
     for (auto i = 1; i <= num_cols; i++) {
         auto& column = _columns.emplace_back(Column::FromFitsPtr(file_ptr, i, col_offset));
+        column->SetStorage(_storage);
         // Resize column's entries vector to contain all rows
         column->Resize(_num_rows);
         // Add columns to map
@@ -222,17 +262,54 @@ bool Table::ConstructFromFITS(bool header_only) {
         }
     }
     if (_num_rows) {
-        // Read entire table into a memory buffer
-        std::size_t size_bytes = total_width * _num_rows;
-        auto buffer = make_unique<uint8_t[]>(size_bytes);
-        fits_read_tblbytes(file_ptr, 1, 1, size_bytes, buffer.get(), &status);
+        // Rows are divided into one contiguous range per thread, as in the static schedule of the kernels that scan the
+        // columns. Entries are not initialized when the columns are resized, so each page of entries is first touched by
+        // the thread that fills and later scans it, and is placed in the memory of that thread's NUMA node
+        int num_threads = MaxThreadCount();
+        vector<int64_t> range_starts(num_threads + 1);
+        for (int t = 0; t <= num_threads; t++) {
+            range_starts[t] = _num_rows * t / num_threads;
+        }
+        int64_t max_range_rows = (_num_rows + num_threads - 1) / num_threads;
+
+        // The table is read in chunks holding the next part of every thread's range, so that only one chunk of the file is
+        // held in memory alongside the columns
+        int64_t part_rows = min(max(int64_t(read_chunk_size / total_width / num_threads), int64_t(1)), max_range_rows);
+        auto buffer = make_unique<uint8_t[]>(part_rows * num_threads * total_width);
+        auto part_start = [&](int t, int64_t offset) {
+            return min(range_starts[t] + offset, range_starts[t + 1]);
+        };
+        auto part_size = [&](int t, int64_t offset) {
+            return int(min(part_rows, range_starts[t + 1] - part_start(t, offset)));
+        };
+        for (int64_t offset = 0; offset < max_range_rows; offset += part_rows) {
+            for (int t = 0; t < num_threads; t++) {
+                if (part_size(t, offset)) {
+                    fits_read_tblbytes(file_ptr, part_start(t, offset) + 1, 1, int64_t(part_size(t, offset)) * total_width,
+                        buffer.get() + t * part_rows * total_width, &status);
+                }
+            }
+            // The buffer is reused for every chunk, so a failed read would otherwise fill rows with a previous chunk's data
+            if (status) {
+                fmt::print("Could not read table data from {}\n", _filename);
+                status = 0;
+                fits_close_file(file_ptr, &status);
+                return false;
+            }
+
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+            for (int t = 0; t < num_threads; t++) {
+                for (auto& column: _columns) {
+                    column->FillFromBuffer(buffer.get() + t * part_rows * total_width, part_size(t, offset), total_width, part_start(t, offset));
+                }
+            }
+        }
         // File is no longer needed after table is read
         fits_close_file(file_ptr, &status);
 
-        // Dynamic schedule of OpenMP division, as some columns will be easier to parse than others
-#pragma omp parallel for default(none) schedule(dynamic) shared(num_cols, buffer, _num_rows, total_width)
-        for (auto i = 0; i < num_cols; i++) {
-            _columns[i]->FillFromBuffer(buffer.get(), _num_rows, total_width);
+        // Block statistics can only be computed once all rows have been filled
+        for (auto& column: _columns) {
+            column->ComputeBlockStatistics();
         }
     } else {
         fits_close_file(file_ptr, &status);
@@ -240,6 +317,233 @@ bool Table::ConstructFromFITS(bool header_only) {
     return true;
 }
 
+// Serializes the metadata in a table cache header
+struct CacheHeaderWriter {
+    string buffer;
+
+    template<class T>
+    void Write(const T& val) {
+        buffer.append(reinterpret_cast<const char*>(&val), sizeof(T));
+    }
+
+    void WriteString(const string& str) {
+        Write(uint64_t(str.size()));
+        buffer.append(str);
+    }
+};
+
+// Reads the metadata in a table cache header, failing rather than reading past the end of the file
+struct CacheHeaderReader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+
+    template<class T>
+    bool Read(T& val) {
+        if (size - offset < sizeof(T)) {
+            return false;
+        }
+        memcpy(&val, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool ReadString(string& str) {
+        uint64_t length;
+        if (!Read(length) || size - offset < length) {
+            return false;
+        }
+        str.assign(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return true;
+    }
+};
+
+// Identifies the version of the source file that a cache was written from
+static bool SourceIdentity(const string& filename, string& path, uint64_t& size, int64_t& modified_time) {
+    error_code path_error, size_error, time_error;
+    path = filesystem::canonical(filename, path_error).string();
+    size = filesystem::file_size(filename, size_error);
+    modified_time = filesystem::last_write_time(filename, time_error).time_since_epoch().count();
+    return !path_error && !size_error && !time_error;
+}
+
+string Table::CachePath() const {
+    return _filename + TABLE_CACHE_SUFFIX;
+}
+
+bool Table::ConstructFromCache() {
+    string source_path;
+    uint64_t source_size;
+    int64_t source_time;
+    if (!SourceIdentity(_filename, source_path, source_size, source_time)) {
+        return false;
+    }
+
+    int file_descriptor = open(CachePath().c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+    struct stat cache_stat;
+    void* mapping = MAP_FAILED;
+    size_t cache_size = 0;
+    if (fstat(file_descriptor, &cache_stat) == 0 && cache_stat.st_size > 0) {
+        cache_size = cache_stat.st_size;
+        mapping = mmap(nullptr, cache_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    }
+    close(file_descriptor);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    auto data = static_cast<const uint8_t*>(mapping);
+    CacheHeaderReader reader = {data, cache_size};
+    char magic[8];
+    uint32_t version;
+    string cached_path;
+    uint64_t cached_size, num_rows, num_columns;
+    int64_t cached_time;
+    bool valid = reader.Read(magic) && memcmp(magic, TABLE_CACHE_MAGIC, sizeof(magic)) == 0 && reader.Read(version) &&
+        version == TABLE_CACHE_VERSION && reader.ReadString(cached_path) && reader.Read(cached_size) && reader.Read(cached_time) &&
+        cached_path == source_path && cached_size == source_size && cached_time == source_time && reader.Read(num_rows) &&
+        num_rows <= cache_size && reader.Read(num_columns);
+
+    vector<uint64_t> column_offsets, column_sizes;
+    for (uint64_t i = 0; valid && i < num_columns; i++) {
+        uint32_t data_type;
+        uint64_t data_type_size, data_offset, column_offset, column_size;
+        string name;
+        valid = reader.Read(data_type) && data_type <= BOOL && reader.ReadString(name);
+        if (!valid) {
+            break;
+        }
+        auto& column = _columns.emplace_back(Column::FromDataType(DataType(data_type), name));
+        column->SetStorage(_storage);
+        valid = column->data_type == DataType(data_type) && reader.ReadString(column->id) && reader.ReadString(column->unit) &&
+            reader.ReadString(column->ucd) && reader.ReadString(column->ref) && reader.ReadString(column->description) &&
+            reader.ReadString(column->data_type_string) && reader.Read(data_type_size) && reader.Read(data_offset) &&
+            reader.Read(column_offset) && reader.Read(column_size) && column_offset <= cache_size && column_size <= cache_size - column_offset;
+        column->data_type_size = data_type_size;
+        column->data_offset = data_offset;
+        column_offsets.push_back(column_offset);
+        column_sizes.push_back(column_size);
+    }
+
+    if (valid) {
+        int64_t num_loaded = _columns.size();
+#pragma omp parallel for schedule(dynamic) reduction(&&:valid)
+        for (int64_t i = 0; i < num_loaded; i++) {
+            valid = _columns[i]->LoadCacheData(data + column_offsets[i], column_sizes[i], num_rows) && valid;
+            _columns[i]->ComputeBlockStatistics();
+        }
+    }
+    munmap(mapping, cache_size);
+
+    if (!valid) {
+        _columns.clear();
+        return false;
+    }
+    _num_rows = num_rows;
+    for (auto& column: _columns) {
+        if (!column->name.empty()) {
+            _column_name_map[column->name] = column.get();
+        }
+        if (!column->id.empty()) {
+            _column_id_map[column->id] = column.get();
+        }
+    }
+    return true;
+}
+
+bool Table::WriteCache() const {
+    string source_path;
+    uint64_t source_size;
+    int64_t source_time;
+    if (!SourceIdentity(_filename, source_path, source_size, source_time)) {
+        return false;
+    }
+
+    // The header is serialized once to find its size, and again once the offsets of the column data are known
+    size_t num_columns = _columns.size();
+    vector<uint64_t> column_offsets(num_columns, 0);
+    vector<uint64_t> column_sizes(num_columns);
+    for (size_t i = 0; i < num_columns; i++) {
+        column_sizes[i] = _columns[i]->CacheDataSize();
+    }
+    auto serialize_header = [&]() {
+        CacheHeaderWriter writer;
+        writer.buffer.append(TABLE_CACHE_MAGIC, 8);
+        writer.Write(uint32_t(TABLE_CACHE_VERSION));
+        writer.WriteString(source_path);
+        writer.Write(source_size);
+        writer.Write(source_time);
+        writer.Write(uint64_t(_num_rows));
+        writer.Write(uint64_t(num_columns));
+        for (size_t i = 0; i < num_columns; i++) {
+            auto& column = _columns[i];
+            writer.Write(uint32_t(column->data_type));
+            writer.WriteString(column->name);
+            writer.WriteString(column->id);
+            writer.WriteString(column->unit);
+            writer.WriteString(column->ucd);
+            writer.WriteString(column->ref);
+            writer.WriteString(column->description);
+            writer.WriteString(column->data_type_string);
+            writer.Write(uint64_t(column->data_type_size));
+            writer.Write(uint64_t(column->data_offset));
+            writer.Write(column_offsets[i]);
+            writer.Write(column_sizes[i]);
+        }
+        return writer.buffer;
+    };
+
+    auto align = [](uint64_t offset) {
+        return (offset + TABLE_CACHE_ALIGNMENT - 1) / TABLE_CACHE_ALIGNMENT * TABLE_CACHE_ALIGNMENT;
+    };
+    uint64_t offset = align(serialize_header().size());
+    for (size_t i = 0; i < num_columns; i++) {
+        column_offsets[i] = offset;
+        offset = align(offset + column_sizes[i]);
+    }
+    auto header = serialize_header();
+    size_t cache_size = offset;
+
+    // The cache is written to a temporary file and renamed, so that readers never see a partially written cache
+    auto temporary_path = fmt::format("{}.{}.tmp", CachePath(), getpid());
+    int file_descriptor = open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file_descriptor < 0) {
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (ftruncate(file_descriptor, cache_size) == 0) {
+        mapping = mmap(nullptr, cache_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+    }
+    close(file_descriptor);
+    if (mapping == MAP_FAILED) {
+        filesystem::remove(temporary_path);
+        return false;
+    }
+
+    auto data = static_cast<uint8_t*>(mapping);
+    memcpy(data, header.data(), header.size());
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < num_columns; i++) {
+        _columns[i]->FillCacheData(data + column_offsets[i]);
+    }
+    bool written = msync(mapping, cache_size, MS_SYNC) == 0;
+    munmap(mapping, cache_size);
+
+    error_code error;
+    if (written) {
+        filesystem::rename(temporary_path, CachePath(), error);
+    }
+    if (!written || error) {
+        filesystem::remove(temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
 bool Table::IsValid() const {
     return _valid;
 }
@@ -285,6 +589,24 @@ const Column* Table::operator[](const std::string& name_or_id) const {
     return GetColumnByName(name_or_id);
 }
 
+size_t Table::MemorySize() const {
+    // Columns are not modified once the table is shared, and cached structures are counted when they are published, so
+    // measuring never waits for a build
+    size_t memory_size = _cached_memory_size;
+    for (auto& column: _columns) {
+        memory_size += column->MemorySize();
+    }
+    return memory_size;
+}
+
+size_t Table::CompressColumns() {
+    size_t num_compressed = 0;
+    for (auto& column: _columns) {
+        num_compressed += column->Compress();
+    }
+    return num_compressed;
+}
+
 size_t Table::NumColumns() const {
     return _columns.size();
 }
@@ -297,4 +619,161 @@ TableView Table::View() const {
     return TableView(*this);
 }
 
-}
\ No newline at end of file
+template<class T, class Map, class Build>
+const T* Table::CachedBuild(Map& cache, const typename Map::key_type& key, bool build, Build build_function) const {
+    std::promise<std::shared_ptr<const T>> build_promise;
+    std::shared_future<std::shared_ptr<const T>> result;
+    {
+        std::lock_guard<std::mutex> guard(_cache_mutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            result = it->second;
+        } else if (build) {
+            cache[key] = build_promise.get_future().share();
+        } else {
+            return nullptr;
+        }
+    }
+
+    if (result.valid()) {
+        if (!build && result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return nullptr;
+        }
+        return result.get().get();
+    }
+
+    std::shared_ptr<const T> built;
+    try {
+        built = build_function();
+    } catch (...) {
+        // Waiting requests receive the exception, and later requests try again
+        build_promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> guard(_cache_mutex);
+        cache.erase(key);
+        throw;
+    }
+    build_promise.set_value(built);
+    return built.get();
+}
+
+const IndexList* Table::SortedIndices(const Column* column, bool build) const {
+    if (!column || column->data_type == UNKNOWN_TYPE || column->NumEntries() != _num_rows) {
+        return nullptr;
+    }
+
+    return CachedBuild<IndexList>(_sorted_indices, column, build, [&]() {
+        auto indices = std::make_shared<IndexList>(_num_rows);
+        std::iota(indices->begin(), indices->end(), 0);
+        column->SortIndices(*indices, true);
+        _cached_memory_size += indices->capacity() * sizeof(int64_t);
+        return indices;
+    });
+}
+
+const QuantileSketch* Table::ColumnSketch(const Column* column) const {
+    if (!column || column->data_type == UNKNOWN_TYPE || column->NumEntries() != _num_rows) {
+        return nullptr;
+    }
+
+    // Columns that cannot be sketched are cached as null sketches, so that they are not scanned again
+    return CachedBuild<QuantileSketch>(_column_sketches, column, true, [&]() {
+        auto sketch = std::make_shared<QuantileSketch>();
+        if (!column->FillQuantileSketch(IndexList(), false, *sketch)) {
+            return std::shared_ptr<QuantileSketch>();
+        }
+        _cached_memory_size += sketch->MemorySize();
+        return sketch;
+    });
+}
+
+const SpatialIndex* Table::SkyIndex(const Column* ra_column, const Column* dec_column) const {
+    if (!ValidPositionColumn(ra_column) || !ValidPositionColumn(dec_column)) {
+        return nullptr;
+    }
+
+    return CachedBuild<SpatialIndex>(_sky_indices, {ra_column, dec_column}, true, [&]() {
+        auto view = View();
+        auto index = std::make_shared<SpatialIndex>(view.ValuesAs<double>(ra_column), view.ValuesAs<double>(dec_column));
+        _cached_memory_size += index->MemorySize();
+        return index;
+    });
+}
+
+bool Table::CrossMatch(const Column* ra_column, const Column* dec_column, const Table& other, const Column* other_ra_column,
+    const Column* other_dec_column, double radius, std::vector<MatchedRows>& matches, CrossMatchMode mode) const {
+    matches.clear();
+    if (!(radius >= 0) || !ValidPositionColumn(ra_column) || !ValidPositionColumn(dec_column) ||
+        !other.ValidPositionColumn(other_ra_column) || !other.ValidPositionColumn(other_dec_column)) {
+        return false;
+    }
+
+    // The larger table is indexed, and the smaller table probes it. Best matches always probe the other table's index with
+    // the rows of this table, so that only the nearest row for each row of this table is ever stored
+    bool index_other = mode == BEST_MATCH || other.NumRows() >= NumRows();
+    auto index = index_other ? other.SkyIndex(other_ra_column, other_dec_column) : SkyIndex(ra_column, dec_column);
+    auto& probe_table = index_other ? *this : other;
+    auto probe_view = probe_table.View();
+    auto probe_ra = probe_view.ValuesAs<double>(index_other ? ra_column : other_ra_column);
+    auto probe_dec = probe_view.ValuesAs<double>(index_other ? dec_column : other_dec_column);
+    bool probe_nearest = mode == BEST_MATCH;
+
+    int64_t num_probes = probe_ra.size();
+    int64_t num_blocks = (num_probes + CROSS_MATCH_BLOCK_SIZE - 1) / CROSS_MATCH_BLOCK_SIZE;
+    std::vector<std::vector<MatchedRows>> thread_matches(MaxThreadCount());
+#pragma omp parallel
+    {
+        auto& local_matches = thread_matches[ThreadIndex()];
+        IndexList rows;
+        std::vector<double> separations;
+
+#pragma omp for schedule(dynamic)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_end = std::min((block + 1) * CROSS_MATCH_BLOCK_SIZE, num_probes);
+            for (int64_t i = block * CROSS_MATCH_BLOCK_SIZE; i < block_end; i++) {
+                if (probe_nearest) {
+                    double separation;
+                    auto row = index->NearestNeighbour(probe_ra[i], probe_dec[i], radius, separation);
+                    if (row >= 0) {
+                        local_matches.push_back({i, row, separation});
+                    }
+                    continue;
+                }
+
+                rows.clear();
+                separations.clear();
+                index->Neighbours(probe_ra[i], probe_dec[i], radius, rows, separations);
+                for (size_t j = 0; j < rows.size(); j++) {
+                    if (index_other) {
+                        local_matches.push_back({i, rows[j], separations[j]});
+                    } else {
+                        local_matches.push_back({rows[j], i, separations[j]});
+                    }
+                }
+            }
+        }
+    }
+
+    size_t num_matches = 0;
+    for (auto& local_matches: thread_matches) {
+        num_matches += local_matches.size();
+    }
+    matches.reserve(num_matches);
+    for (auto& local_matches: thread_matches) {
+        matches.insert(matches.end(), local_matches.begin(), local_matches.end());
+        std::vector<MatchedRows>().swap(local_matches);
+    }
+
+    tbb::parallel_sort(matches.begin(), matches.end(), [](const MatchedRows& a, const MatchedRows& b) {
+        if (a.row != b.row) {
+            return a.row < b.row;
+        }
+        return a.separation != b.separation ? a.separation < b.separation : a.other_row < b.other_row;
+    });
+    return true;
+}
+
+bool Table::ValidPositionColumn(const Column* column) const {
+    return column && column->data_type != UNKNOWN_TYPE && column->data_type != STRING && column->NumEntries() == _num_rows;
+}
+
+}
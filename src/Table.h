@@ -4,21 +4,55 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <future>
 #include "Columns.h"
+#include "SpatialIndex.h"
 #include "TableView.h"
 
 #define MAX_HEADER_SIZE (64 * 1024)
 // Valid for little-endian only
 #define XML_MAGIC_NUMBER 0x6D783F3C
 #define FITS_MAGIC_NUMBER 0x504D4953
+// Suffix appended to a table's filename to give the path of its column cache
+#define TABLE_CACHE_SUFFIX ".colcache"
+#define TABLE_CACHE_MAGIC "CARTACOL"
+#define TABLE_CACHE_VERSION 1
+// Column data in a table cache starts on page boundaries
+#define TABLE_CACHE_ALIGNMENT 4096
+// Number of rows probed together by each thread during a cross-match
+#define CROSS_MATCH_BLOCK_SIZE 1024
+// Tables from smaller files allocate their column entries from the heap rather than from an arena of huge-page slabs
+#define ARENA_MIN_FILE_SIZE (size_t(16) << 20)
+// Default maximum number of bytes of FITS table data read into memory at a time
+#define FITS_READ_CHUNK_SIZE (256 * 1024 * 1024)
 
 namespace carta {
 
 class TableView;
 
+enum CrossMatchMode {
+    BEST_MATCH = 0,
+    ALL_MATCHES = 1
+};
+
+// Rows of two tables with sky positions matched by a cross-match, and their separation in degrees
+struct MatchedRows {
+    int64_t row;
+    int64_t other_row;
+    double separation;
+};
+
 class Table {
 public:
-    Table(const std::string& filename, bool header_only = false);
+    // If use_cache is true, the table is loaded from its column cache when the cache matches the file, and the cache is
+    // written after loading the file otherwise. If a scratch directory is given, the column entries are stored out of
+    // core in a scratch file in that directory, so that tables larger than physical memory can be loaded. FITS table data is
+    // read into memory in chunks of at most read_chunk_size bytes
+    Table(const std::string& filename, bool header_only = false, bool use_cache = false, const std::string& scratch_directory = "",
+        size_t read_chunk_size = FITS_READ_CHUNK_SIZE);
     bool IsValid() const;
     void PrintInfo(bool skip_unknowns = true) const;
     const Column* GetColumnByName(const std::string& name) const;
@@ -26,6 +60,27 @@ public:
     size_t NumColumns() const;
     size_t NumRows() const;
     TableView View() const;
+    // Permutation of all row indices in ascending order of the column's values (NaNs last).
+    // Built on first use and cached. If build is false, only a previously cached permutation is returned
+    const IndexList* SortedIndices(const Column* column, bool build = true) const;
+    // Quantile sketch of all of the column's entries, built on first use and cached
+    const QuantileSketch* ColumnSketch(const Column* column) const;
+    // Spatial index of the sky positions given by RA and Dec columns in degrees, built on first use and cached
+    const SpatialIndex* SkyIndex(const Column* ra_column, const Column* dec_column) const;
+    // Matches the sky positions of this table's rows to those of another table's rows within a radius in degrees. For all
+    // matches, the spatial index of the larger table is probed in parallel with the positions of the smaller table. Best
+    // matches probe the other table's index with this table's positions and keep only the nearest row of the other table
+    // for each row of this table, so their memory does not grow with the number of pairs within the radius. Matches are
+    // ordered by row, then by separation
+    bool CrossMatch(const Column* ra_column, const Column* dec_column, const Table& other, const Column* other_ra_column,
+        const Column* other_dec_column, double radius, std::vector<MatchedRows>& matches, CrossMatchMode mode = BEST_MATCH) const;
+
+    // Approximate heap memory used by the columns and by the cached sorted indices, sketches and sky indices that have
+    // finished building, in bytes. Does not wait for builds in progress
+    size_t MemorySize() const;
+    // Compresses the integer columns whose entries can be packed into less memory, returning the number of compressed
+    // columns. Must be called before the table is shared with other threads
+    size_t CompressColumns();
 
     const Column* operator[](size_t i) const;
     const Column* operator[](const std::string& name_or_id) const;
@@ -35,14 +90,36 @@ protected:
     bool PopulateFields(const pugi::xml_node& table);
     bool PopulateRows(const pugi::xml_node& table);
 
-    bool ConstructFromFITS(bool header_only = false);
+    bool ConstructFromFITS(bool header_only = false, size_t read_chunk_size = FITS_READ_CHUNK_SIZE);
+    // The column cache is a sidecar file storing the column metadata and raw entries, along with the path, size and
+    // modification time of the source file it was written from
+    std::string CachePath() const;
+    bool ConstructFromCache();
+    bool WriteCache() const;
+    // Whether a column holds numeric entries for every row, as required for sky positions
+    bool ValidPositionColumn(const Column* column) const;
+    // Returns the cached structure for a key, building it on first use. The cache mutex is only held to look up or publish
+    // the structure, so that a long build does not block other lookups or MemorySize; requests for a structure that is
+    // still being built wait for that build. If build is false, a structure that is not yet built is not waited for
+    template<class T, class Map, class Build>
+    const T* CachedBuild(Map& cache, const typename Map::key_type& key, bool build, Build build_function) const;
 
     bool _valid;
     int64_t _num_rows;
     std::string _filename;
+    // Storage of the column entries, in memory or out of core in a scratch file. Null for small tables, whose entries are
+    // allocated from the heap
+    std::shared_ptr<ColumnStorage> _storage;
     std::vector<std::unique_ptr<Column>> _columns;
     std::unordered_map<std::string, Column*> _column_name_map;
     std::unordered_map<std::string, Column*> _column_id_map;
+    // Guards the maps of cached structures below, but not the builds of the structures themselves
+    mutable std::mutex _cache_mutex;
+    // Heap memory of the cached structures that have finished building, in bytes
+    mutable std::atomic<size_t> _cached_memory_size;
+    mutable std::unordered_map<const Column*, std::shared_future<std::shared_ptr<const IndexList>>> _sorted_indices;
+    mutable std::unordered_map<const Column*, std::shared_future<std::shared_ptr<const QuantileSketch>>> _column_sketches;
+    mutable std::map<std::pair<const Column*, const Column*>, std::shared_future<std::shared_ptr<const SpatialIndex>>> _sky_indices;
     static std::string GetHeader(const std::string& filename);
     static uint32_t GetMagicNumber(const std::string& filename) ;
 };
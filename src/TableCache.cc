@@ -0,0 +1,152 @@
+#include "TableCache.h"
+
+#include <filesystem>
+
+namespace carta {
+
+using namespace std;
+
+TableCache::TableCache(size_t memory_budget, bool use_column_cache, bool compress_columns) :
+    _memory_budget(memory_budget),
+    _use_column_cache(use_column_cache),
+    _compress_columns(compress_columns),
+    _next_generation(0) {}
+
+TableCache& TableCache::Global() {
+    static TableCache cache;
+    return cache;
+}
+
+shared_ptr<const Table> TableCache::Get(const string& filename) {
+    error_code path_error, size_error, time_error;
+    auto path = filesystem::canonical(filename, path_error).string();
+    auto file_size = filesystem::file_size(filename, size_error);
+    auto modified_time = filesystem::last_write_time(filename, time_error).time_since_epoch().count();
+    if (path_error || size_error || time_error) {
+        return nullptr;
+    }
+
+    unique_lock<mutex> lock(_mutex);
+    auto it = _entries.find(path);
+    if (it != _entries.end()) {
+        auto& entry = it->second;
+        if (entry.modified_time == modified_time && entry.file_size == file_size) {
+            _lru.splice(_lru.begin(), _lru, entry.lru_position);
+            auto table = entry.table;
+            lock.unlock();
+            return table.get();
+        }
+        // The file has changed since it was loaded
+        Erase(it);
+    }
+
+    promise<shared_ptr<const Table>> load_promise;
+    auto generation = _next_generation++;
+    _lru.push_front(path);
+    _entries[path] = {modified_time, file_size, generation, false, load_promise.get_future().share(), _lru.begin()};
+    lock.unlock();
+
+    shared_ptr<const Table> table;
+    try {
+        auto loaded_table = make_shared<Table>(path, false, _use_column_cache);
+        if (loaded_table->IsValid()) {
+            if (_compress_columns) {
+                loaded_table->CompressColumns();
+            }
+            table = std::move(loaded_table);
+        }
+    } catch (...) {
+        // Requests waiting for the load receive the exception, and the entry is removed so that later requests try again
+        load_promise.set_exception(current_exception());
+        lock.lock();
+        it = _entries.find(path);
+        if (it != _entries.end() && it->second.generation == generation) {
+            Erase(it);
+        }
+        throw;
+    }
+    // The table is published before the entry is marked as loaded, so that eviction never waits for an unfinished load
+    load_promise.set_value(table);
+
+    lock.lock();
+    it = _entries.find(path);
+    if (it != _entries.end() && it->second.generation == generation) {
+        if (table) {
+            it->second.loaded = true;
+            Evict();
+        } else {
+            // Failed loads are not cached, so that later requests try again
+            Erase(it);
+        }
+    }
+    lock.unlock();
+    return table;
+}
+
+void TableCache::SetMemoryBudget(size_t memory_budget) {
+    lock_guard<mutex> guard(_mutex);
+    _memory_budget = memory_budget;
+    Evict();
+}
+
+size_t TableCache::MemoryBudget() const {
+    lock_guard<mutex> guard(_mutex);
+    return _memory_budget;
+}
+
+size_t TableCache::MemoryUsage() const {
+    lock_guard<mutex> guard(_mutex);
+    return CurrentMemoryUsage();
+}
+
+size_t TableCache::NumTables() const {
+    lock_guard<mutex> guard(_mutex);
+    size_t num_tables = 0;
+    for (auto& [path, entry]: _entries) {
+        num_tables += entry.loaded;
+    }
+    return num_tables;
+}
+
+void TableCache::Clear() {
+    lock_guard<mutex> guard(_mutex);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        auto next = std::next(it);
+        if (it->second.loaded) {
+            Erase(it);
+        }
+        it = next;
+    }
+}
+
+size_t TableCache::CurrentMemoryUsage() const {
+    size_t memory_usage = 0;
+    for (auto& [path, entry]: _entries) {
+        if (entry.loaded) {
+            memory_usage += entry.table.get()->MemorySize();
+        }
+    }
+    return memory_usage;
+}
+
+void TableCache::Evict() {
+    // Tables with handles outside the cache would not be freed by evicting them
+    size_t memory_usage = CurrentMemoryUsage();
+    for (auto lru_it = _lru.end(); lru_it != _lru.begin() && memory_usage > _memory_budget;) {
+        auto it = _entries.find(*--lru_it);
+        auto& entry = it->second;
+        if (entry.loaded && entry.table.get().use_count() == 1) {
+            memory_usage -= entry.table.get()->MemorySize();
+            // Erasing removes the entry's own list position, so iteration continues from the next more recent table
+            lru_it = std::next(lru_it);
+            Erase(it);
+        }
+    }
+}
+
+void TableCache::Erase(unordered_map<string, Entry>::iterator it) {
+    _lru.erase(it->second.lru_position);
+    _entries.erase(it);
+}
+
+}
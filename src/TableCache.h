@@ -0,0 +1,69 @@
+#ifndef VOTABLE_TEST__TABLECACHE_H_
+#define VOTABLE_TEST__TABLECACHE_H_
+
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Table.h"
+
+// Memory budget of a table cache, in bytes, unless another budget is given
+#define TABLE_CACHE_DEFAULT_BUDGET (size_t(8) << 30)
+
+namespace carta {
+
+// Cache of loaded tables shared between sessions, so that each file is loaded only once. Tables are identified by the
+// canonical path and modification time of their file, and a request for a table that is still being loaded waits for
+// that load. When the memory used by the cached tables exceeds the budget, the least recently used tables without any
+// handles outside the cache are evicted
+class TableCache {
+public:
+    // Tables are loaded from their column caches if use_column_cache is true, and have their integer columns compressed
+    // after loading if compress_columns is true
+    TableCache(size_t memory_budget = TABLE_CACHE_DEFAULT_BUDGET, bool use_column_cache = false, bool compress_columns = false);
+    // Process-wide cache
+    static TableCache& Global();
+
+    // Shared handle to the table loaded from the file, or nullptr if the file cannot be loaded. Exceptions thrown while
+    // loading are passed on to every request waiting for the load
+    std::shared_ptr<const Table> Get(const std::string& filename);
+    void SetMemoryBudget(size_t memory_budget);
+    size_t MemoryBudget() const;
+    size_t MemoryUsage() const;
+    size_t NumTables() const;
+    // Removes all loaded tables from the cache. Handles to the tables remain valid
+    void Clear();
+
+protected:
+    struct Entry {
+        int64_t modified_time;
+        uint64_t file_size;
+        // Distinguishes entries for the same path, so that a load only updates the entry it was started for
+        uint64_t generation;
+        bool loaded;
+        std::shared_future<std::shared_ptr<const Table>> table;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    // Memory used by the loaded tables, measured on each call as tables grow when they cache sorted indices, sketches and
+    // sky indices. Must be called with the mutex held
+    size_t CurrentMemoryUsage() const;
+    // Evicts unused tables in order of least recent use until the budget is met. Must be called with the mutex held
+    void Evict();
+    void Erase(std::unordered_map<std::string, Entry>::iterator it);
+
+    mutable std::mutex _mutex;
+    size_t _memory_budget;
+    bool _use_column_cache;
+    bool _compress_columns;
+    uint64_t _next_generation;
+    std::unordered_map<std::string, Entry> _entries;
+    // Canonical paths of the cached tables, with the most recently used first
+    std::list<std::string> _lru;
+};
+}
+
+#endif //VOTABLE_TEST__TABLECACHE_H_
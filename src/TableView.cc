@@ -1,15 +1,21 @@
 #include "TableView.h"
 #include "Table.h"
+#include "RadixSort.tcc"
+#include "Geometry.h"
 
 #include <numeric>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <tbb/parallel_sort.h>
 
 namespace carta {
 
 using namespace std;
 
 TableView::TableView(const Table& table) :
-    _table(table) {
+    _table(table),
+    _cache(std::make_shared<ViewCache>()) {
     _is_subset = false;
     _ordered = true;
 }
@@ -17,11 +23,13 @@ TableView::TableView(const Table& table) :
 TableView::TableView(const Table& table, const IndexList& index_list, bool ordered) :
     _table(table),
     _subset_indices(index_list),
-    _ordered(ordered) {
+    _ordered(ordered),
+    _cache(std::make_shared<ViewCache>()) {
     _is_subset = true;
 }
 
 bool TableView::NumericFilter(const Column* column, ComparisonOperator comparison_operator, double value, double secondary_value) {
+    InvalidateCache();
     if (!column) {
         return false;
     }
@@ -31,7 +39,31 @@ bool TableView::NumericFilter(const Column* column, ComparisonOperator compariso
         return false;
     }
 
-    column->FilterIndices(_subset_indices, _is_subset, comparison_operator, value, secondary_value);
+    // Use a cached sorted index if there is one, and it is cheaper than scanning
+    size_t begin, end;
+    auto sorted_indices = _table.SortedIndices(column, false);
+    if (sorted_indices && column->SortedRange(*sorted_indices, comparison_operator, value, secondary_value, begin, end)
+        && SortCost(end - begin) < NumRows()) {
+        IndexList matching_indices(sorted_indices->begin() + begin, sorted_indices->begin() + end);
+        sort(matching_indices.begin(), matching_indices.end());
+
+        if (_is_subset) {
+            IndexList combined_indices;
+            if (_ordered) {
+                set_intersection(_subset_indices.begin(), _subset_indices.end(), matching_indices.begin(), matching_indices.end(), back_inserter(combined_indices));
+            } else {
+                // Preserve the existing order of unordered subsets
+                copy_if(_subset_indices.begin(), _subset_indices.end(), back_inserter(combined_indices), [&](int64_t i) {
+                    return binary_search(matching_indices.begin(), matching_indices.end(), i);
+                });
+            }
+            _subset_indices.swap(combined_indices);
+        } else {
+            _subset_indices.swap(matching_indices);
+        }
+    } else {
+        column->FilterIndices(_subset_indices, _is_subset, comparison_operator, value, secondary_value);
+    }
     size_t num_entries = column->NumEntries();
 
     if (_subset_indices.size() == num_entries) {
@@ -45,6 +77,7 @@ bool TableView::NumericFilter(const Column* column, ComparisonOperator compariso
 }
 
 bool TableView::StringFilter(const Column* column, string search_string, bool case_insensitive) {
+    InvalidateCache();
     IndexList matching_indices;
 
     auto string_column = DataColumn<string>::TryCast(column);
@@ -110,7 +143,84 @@ bool TableView::StringFilter(const Column* column, string search_string, bool ca
     return true;
 }
 
+bool TableView::ConeFilter(const Column* ra_column, const Column* dec_column, double ra, double dec, double radius) {
+    auto index = _table.SkyIndex(ra_column, dec_column);
+    IndexList rows;
+    if (!index || !index->ConeSearch(ra, dec, radius, rows)) {
+        return false;
+    }
+    return IntersectRows(rows);
+}
+
+bool TableView::SkyBoxFilter(const Column* ra_column, const Column* dec_column, double ra_min, double ra_max, double dec_min, double dec_max) {
+    auto index = _table.SkyIndex(ra_column, dec_column);
+    IndexList rows;
+    if (!index || !index->BoxSearch(ra_min, ra_max, dec_min, dec_max, rows)) {
+        return false;
+    }
+    return IntersectRows(rows);
+}
+
+bool TableView::SkyPolygonFilter(const Column* ra_column, const Column* dec_column, const std::vector<double>& ra, const std::vector<double>& dec) {
+    auto index = _table.SkyIndex(ra_column, dec_column);
+    IndexList rows;
+    if (!index || !index->PolygonSearch(ra, dec, rows)) {
+        return false;
+    }
+    return IntersectRows(rows);
+}
+
+bool TableView::PolygonFilter(const Column* x_column, const Column* y_column, const std::vector<double>& polygon_x,
+    const std::vector<double>& polygon_y) {
+    PolygonGrid grid(polygon_x, polygon_y);
+    if (!grid.IsValid()) {
+        return false;
+    }
+    return RegionFilter(x_column, y_column, [&](const double* x, const double* y, int64_t num_values, uint8_t* keep) {
+        grid.Contains(x, y, num_values, keep);
+    });
+}
+
+bool TableView::EllipseFilter(const Column* x_column, const Column* y_column, double x_centre, double y_centre, double semi_major,
+    double semi_minor, double angle) {
+    if (!isfinite(x_centre) || !isfinite(y_centre) || !isfinite(angle) || !(semi_major > 0) || !(semi_minor > 0)) {
+        return false;
+    }
+
+    // Offsets are rotated onto the ellipse axes and scaled to a unit circle
+    double cos_angle = cos(angle * M_PI / 180.0) / semi_major;
+    double sin_angle = sin(angle * M_PI / 180.0) / semi_major;
+    double minor_cos_angle = cos(angle * M_PI / 180.0) / semi_minor;
+    double minor_sin_angle = sin(angle * M_PI / 180.0) / semi_minor;
+    return RegionFilter(x_column, y_column, [&](const double* x, const double* y, int64_t num_values, uint8_t* keep) {
+#pragma omp simd
+        for (int64_t i = 0; i < num_values; i++) {
+            double dx = x[i] - x_centre;
+            double dy = y[i] - y_centre;
+            double u = dx * cos_angle + dy * sin_angle;
+            double v = dy * minor_cos_angle - dx * minor_sin_angle;
+            keep[i] = u * u + v * v <= 1.0;
+        }
+    });
+}
+
+bool TableView::IsNumeric(const Column* column) {
+    return column && column->data_type != UNKNOWN_TYPE && column->data_type != STRING && column->data_type != BOOL;
+}
+
+bool TableView::IntersectRows(const IndexList& rows) {
+    InvalidateCache();
+    if (!_is_subset) {
+        _is_subset = true;
+        _ordered = true;
+        _subset_indices = rows;
+        return true;
+    }
+    return Combine(TableView(_table, rows), INTERSECTION);
+}
+
 bool TableView::Invert() {
+    InvalidateCache();
     IndexList inverted_indices;
     auto total_row_count = _table.NumRows();
 
@@ -142,7 +252,13 @@ bool TableView::Invert() {
             }
             _subset_indices = inverted_indices;
         } else {
-            return false;
+            // Unordered subsets are inverted through a bitmap, and the inverted view is ordered by index
+            auto bitmap = IndicesToBitmap(_subset_indices, total_row_count);
+            for (auto& word: bitmap) {
+                word = ~word;
+            }
+            _subset_indices = BitmapToIndices(bitmap, total_row_count);
+            _ordered = true;
         }
     } else {
         // Inverse of ALL is NONE
@@ -153,35 +269,101 @@ bool TableView::Invert() {
 }
 
 void TableView::Reset() {
+    InvalidateCache();
     _is_subset = false;
     _subset_indices.clear();
     _ordered = true;
 }
 
-bool TableView::Combine(const TableView& second) {
+bool TableView::Combine(const TableView& second, CombinationOperator combination_operator) {
     // If the views point to different tables, the combined table is not valid
     if (&_table != &second._table) {
         return false;
     }
-    // If either table is not a subset, the combined table is not a subset
-    if (!(_is_subset && second._is_subset)) {
-        _is_subset = false;
+    InvalidateCache();
+
+    // Combinations involving a view of the entire table reduce to copies or inversions
+    if (!second._is_subset) {
+        if (combination_operator == UNION) {
+            Reset();
+        } else if (combination_operator == SYMMETRIC_DIFFERENCE) {
+            Invert();
+        } else if (combination_operator == DIFFERENCE) {
+            _is_subset = true;
+            _ordered = true;
+            _subset_indices.clear();
+        }
         return true;
     }
-
-    // If either table has unordered indices, they cannot be combined
-    if (!(_ordered && second._ordered)) {
-        return false;
+    if (!_is_subset) {
+        if (combination_operator != UNION) {
+            _is_subset = true;
+            _ordered = second._ordered;
+            _subset_indices = second._subset_indices;
+            if (combination_operator != INTERSECTION) {
+                Invert();
+            }
+        }
+        return true;
     }
 
+    size_t num_rows = _table.NumRows();
+    auto& first_indices = _subset_indices;
+    auto& second_indices = second._subset_indices;
     IndexList combined_indices;
-    set_union(_subset_indices.begin(), _subset_indices.end(), second._subset_indices.begin(), second._subset_indices.end(), back_inserter(combined_indices));
-    if (combined_indices.size() == _table.NumRows()) {
+
+    if (!_ordered && (combination_operator == INTERSECTION || combination_operator == DIFFERENCE)) {
+        // Filtering an unordered view by the second view preserves its existing order
+        auto second_bitmap = IndicesToBitmap(second_indices, num_rows);
+        bool keep_members = combination_operator == INTERSECTION;
+        copy_if(first_indices.begin(), first_indices.end(), back_inserter(combined_indices), [&](int64_t i) {
+            return BitmapContains(second_bitmap, i, num_rows) == keep_members;
+        });
+    } else if (_ordered && second._ordered && (first_indices.size() + second_indices.size()) * BITMAP_DENSITY_THRESHOLD < num_rows) {
+        // Sparse ordered views are merged directly
+        size_t first_size = first_indices.size();
+        size_t second_size = second_indices.size();
+        if (combination_operator == INTERSECTION && first_size * GALLOP_SIZE_RATIO < second_size) {
+            GallopingFilter(first_indices, second_indices, true, combined_indices);
+        } else if (combination_operator == INTERSECTION && second_size * GALLOP_SIZE_RATIO < first_size) {
+            GallopingFilter(second_indices, first_indices, true, combined_indices);
+        } else if (combination_operator == DIFFERENCE && first_size * GALLOP_SIZE_RATIO < second_size) {
+            GallopingFilter(first_indices, second_indices, false, combined_indices);
+        } else if (combination_operator == INTERSECTION) {
+            set_intersection(first_indices.begin(), first_indices.end(), second_indices.begin(), second_indices.end(), back_inserter(combined_indices));
+        } else if (combination_operator == SYMMETRIC_DIFFERENCE) {
+            set_symmetric_difference(first_indices.begin(), first_indices.end(), second_indices.begin(), second_indices.end(), back_inserter(combined_indices));
+        } else if (combination_operator == DIFFERENCE) {
+            set_difference(first_indices.begin(), first_indices.end(), second_indices.begin(), second_indices.end(), back_inserter(combined_indices));
+        } else {
+            set_union(first_indices.begin(), first_indices.end(), second_indices.begin(), second_indices.end(), back_inserter(combined_indices));
+        }
+        _ordered = true;
+    } else {
+        // Dense or unordered views are combined as bitmaps, which produces an ordered view
+        auto first_bitmap = IndicesToBitmap(first_indices, num_rows);
+        auto second_bitmap = IndicesToBitmap(second_indices, num_rows);
+        int64_t num_words = first_bitmap.size();
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < num_words; i++) {
+            auto a = first_bitmap[i];
+            auto b = second_bitmap[i];
+            first_bitmap[i] = combination_operator == INTERSECTION ? (a & b)
+                : combination_operator == SYMMETRIC_DIFFERENCE ? (a ^ b)
+                : combination_operator == DIFFERENCE ? (a & ~b)
+                : (a | b);
+        }
+        combined_indices = BitmapToIndices(first_bitmap, num_rows);
+        _ordered = true;
+    }
+
+    // Unordered views containing all rows remain subsets, so that their order is retained
+    if (_ordered && combined_indices.size() == num_rows) {
         _subset_indices.clear();
         _is_subset = false;
     } else {
         _is_subset = true;
-        _subset_indices = combined_indices;
+        _subset_indices.swap(combined_indices);
     }
 
     return true;
@@ -196,19 +378,214 @@ bool TableView::SortByColumn(const Column* column, bool ascending) {
         return false;
     }
 
-    // If we're sorting an entire column, we first need to populate the indices
+    size_t num_rows = _table.NumRows();
+    if (!_is_subset) {
+        // If we're sorting an entire column, the cached sorted index can simply be copied
+        auto sorted_indices = _table.SortedIndices(column);
+        if (sorted_indices) {
+            _subset_indices = *sorted_indices;
+        } else {
+            _subset_indices.resize(num_rows);
+            std::iota(_subset_indices.begin(), _subset_indices.end(), 0);
+            column->SortIndices(_subset_indices, true);
+        }
+        _is_subset = true;
+        if (!ascending) {
+            // NaN entries remain at the end of the list
+            reverse(_subset_indices.begin(), _subset_indices.begin() + column->NumValidSorted(_subset_indices));
+        }
+    } else if (SortCost(_subset_indices.size()) <= num_rows || !SortSubsetFromIndex(column, ascending)) {
+        // Small subsets are sorted directly, while large subsets are extracted from the sorted index in linear time
+        column->SortIndices(_subset_indices, ascending);
+    }
+
+    // After sorting by a specific column, the table view is no longer ordered by index
+    _ordered = false;
+    return true;
+}
+
+bool TableView::PartialSortByColumn(const Column* column, int64_t start, int64_t end, bool ascending) {
+    if (!column || column->data_type == UNKNOWN_TYPE) {
+        return false;
+    }
+
+    // A full sort is cheaper than a partial sort if the sorted index can be copied
+    if (!_is_subset && _table.SortedIndices(column, false)) {
+        return SortByColumn(column, ascending);
+    }
+
     if (!_is_subset) {
         _subset_indices.resize(_table.NumRows());
         std::iota(_subset_indices.begin(), _subset_indices.end(), 0);
         _is_subset = true;
     }
-    column->SortIndices(_subset_indices, ascending);
 
-    // After sorting by a specific column, the table view is no longer ordered by index
+    ClampRange(start, end);
+    column->PartialSortIndices(_subset_indices, start, end, ascending);
+    _ordered = false;
+    return true;
+}
+
+bool TableView::TopByColumn(const Column* column, int64_t num_rows, bool ascending) {
+    InvalidateCache();
+    if (!column || column->data_type == UNKNOWN_TYPE) {
+        return false;
+    }
+    num_rows = std::max(num_rows, (int64_t) 0);
+
+    auto sorted_indices = _is_subset ? nullptr : _table.SortedIndices(column, false);
+    if (sorted_indices) {
+        // The top rows can be read directly from the sorted index, with NaN entries still last
+        size_t num_valid = column->NumValidSorted(*sorted_indices);
+        size_t num_top = std::min((size_t) num_rows, sorted_indices->size());
+        IndexList top_indices;
+        top_indices.reserve(num_top);
+        if (ascending) {
+            top_indices.assign(sorted_indices->begin(), sorted_indices->begin() + num_top);
+        } else {
+            // Runs of equal entries are walked backwards, but each run is emitted in index order, as a stable sort would
+            size_t run_end = num_valid;
+            while (run_end > 0 && top_indices.size() < num_top) {
+                size_t run_begin = run_end - 1;
+                while (run_begin > 0 && column->CompareEntries((*sorted_indices)[run_begin - 1], (*sorted_indices)[run_end - 1]) == 0) {
+                    run_begin--;
+                }
+                for (size_t i = run_begin; i < run_end && top_indices.size() < num_top; i++) {
+                    top_indices.push_back((*sorted_indices)[i]);
+                }
+                run_end = run_begin;
+            }
+            for (size_t i = num_valid; top_indices.size() < num_top; i++) {
+                top_indices.push_back((*sorted_indices)[i]);
+            }
+        }
+        _subset_indices.swap(top_indices);
+    } else {
+        column->TopIndices(_subset_indices, _is_subset, num_rows, ascending);
+    }
+
+    _is_subset = true;
+    _ordered = false;
+    return true;
+}
+
+bool TableView::SortByColumns(const std::vector<SortColumn>& sort_columns) {
+    if (sort_columns.empty()) {
+        return false;
+    }
+    for (auto& sort_column: sort_columns) {
+        if (!sort_column.column || !sort_column.column->NormalizedKeySize()) {
+            return false;
+        }
+    }
+
+    if (!_is_subset) {
+        _subset_indices.resize(_table.NumRows());
+        std::iota(_subset_indices.begin(), _subset_indices.end(), 0);
+        _is_subset = true;
+    }
+
+    // Each row's key is the concatenation of the normalized keys of all the sort columns
+    size_t key_stride = 0;
+    std::vector<size_t> key_offsets;
+    for (auto& sort_column: sort_columns) {
+        key_offsets.push_back(key_stride);
+        key_stride += sort_column.column->NormalizedKeySize();
+    }
+    key_offsets.push_back(key_stride);
+
+    int64_t num_indices = _subset_indices.size();
+    std::vector<uint8_t> keys(num_indices * key_stride);
+    for (auto i = 0; i < sort_columns.size(); i++) {
+        sort_columns[i].column->FillNormalizedKeys(_subset_indices, keys.data() + key_offsets[i], key_stride, sort_columns[i].ascending);
+    }
+
+    // Keys are compared with memcmp, up to the end of each column that may have truncated keys
+    std::vector<size_t> tie_break_columns;
+    for (auto i = 0; i < sort_columns.size(); i++) {
+        if (sort_columns[i].column->data_type == STRING) {
+            tie_break_columns.push_back(i);
+        }
+    }
+
+    auto compare = [&](int64_t a, int64_t b) {
+        auto key_a = keys.data() + a * key_stride;
+        auto key_b = keys.data() + b * key_stride;
+        size_t offset = 0;
+        for (auto i: tie_break_columns) {
+            auto end = key_offsets[i + 1];
+            auto result = memcmp(key_a + offset, key_b + offset, end - offset);
+            if (result) {
+                return result < 0;
+            }
+            auto& sort_column = sort_columns[i];
+            if (sort_column.column->NormalizedKeyTruncated(key_a + key_offsets[i])) {
+                result = sort_column.column->CompareEntries(_subset_indices[a], _subset_indices[b]);
+                if (result) {
+                    return sort_column.ascending ? result < 0 : result > 0;
+                }
+            }
+            offset = end;
+        }
+        auto result = memcmp(key_a + offset, key_b + offset, key_stride - offset);
+        // Ties are broken by the existing position, so that the sort is stable
+        return result ? result < 0 : a < b;
+    };
+
+    std::vector<int64_t> order(num_indices);
+    std::iota(order.begin(), order.end(), 0);
+    tbb::parallel_sort(order.begin(), order.end(), compare);
+
+    IndexList sorted_indices(num_indices);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_indices; i++) {
+        sorted_indices[i] = _subset_indices[order[i]];
+    }
+    _subset_indices.swap(sorted_indices);
     _ordered = false;
     return true;
 }
 
+bool TableView::SortSubsetFromIndex(const Column* column, bool ascending) {
+    auto sorted_indices = _table.SortedIndices(column);
+    if (!sorted_indices) {
+        return false;
+    }
+
+    // Mark the rows in the subset, and then walk the sorted index, keeping only marked rows
+    int64_t num_rows = _table.NumRows();
+    std::vector<uint8_t> in_subset(num_rows, 0);
+    for (auto i: _subset_indices) {
+        if (i >= 0 && i < num_rows) {
+            in_subset[i] = 1;
+        }
+    }
+
+    IndexList sorted_subset;
+    sorted_subset.reserve(_subset_indices.size());
+    for (auto i: *sorted_indices) {
+        if (in_subset[i]) {
+            sorted_subset.push_back(i);
+        }
+    }
+
+    // Subsets with duplicate or invalid indices cannot be sorted this way
+    if (sorted_subset.size() != _subset_indices.size()) {
+        return false;
+    }
+
+    if (!ascending) {
+        reverse(sorted_subset.begin(), sorted_subset.begin() + column->NumValidSorted(sorted_subset));
+    }
+    _subset_indices.swap(sorted_subset);
+    return true;
+}
+
+double TableView::SortCost(size_t num_indices) {
+    // Approximate comparison count of sorting the given number of indices, relative to a linear scan
+    return num_indices * log2(num_indices + 1.0);
+}
+
 bool TableView::SortByIndex() {
     if (!_ordered) {
         sort(_subset_indices.begin(), _subset_indices.end());
@@ -217,10 +594,536 @@ bool TableView::SortByIndex() {
     return true;
 }
 
+bool TableView::Aggregate(const Column* column, ColumnStatistics& stats) const {
+    if (!column) {
+        return false;
+    }
+    return column->Aggregate(_subset_indices, _is_subset, stats);
+}
+
+bool TableView::Histogram(const Column* column, int num_bins, ColumnHistogram& histogram, bool log_scale, double min_val, double max_val) const {
+    if (!column) {
+        return false;
+    }
+
+    auto same_limit = [](double a, double b) {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    };
+
+    {
+        std::lock_guard<std::mutex> guard(_cache->mutex);
+        for (auto& cached: _cache->histograms) {
+            if (cached.column == column && cached.num_bins == num_bins && cached.log_scale == log_scale &&
+                same_limit(cached.min_val, min_val) && same_limit(cached.max_val, max_val)) {
+                histogram = cached.histogram;
+                return true;
+            }
+        }
+    }
+
+    if (!column->FillHistogram(_subset_indices, _is_subset, num_bins, log_scale, min_val, max_val, histogram)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(_cache->mutex);
+    if (_cache->histograms.size() >= HISTOGRAM_CACHE_SIZE) {
+        _cache->histograms.erase(_cache->histograms.begin());
+    }
+    _cache->histograms.push_back({column, num_bins, log_scale, min_val, max_val, histogram});
+    return true;
+}
+
+bool TableView::Quantiles(const Column* column, const std::vector<double>& fractions, std::vector<double>& quantiles, bool exact) const {
+    if (!column) {
+        return false;
+    }
+
+    if (exact) {
+        // A cached sorted index gives exact quantiles of the full table without selection
+        auto sorted_indices = _is_subset ? nullptr : _table.SortedIndices(column, false);
+        if (sorted_indices) {
+            return column->ExactQuantiles(*sorted_indices, true, true, fractions, quantiles);
+        }
+        return column->ExactQuantiles(_subset_indices, _is_subset, false, fractions, quantiles);
+    }
+
+    for (auto fraction: fractions) {
+        if (!(fraction >= 0 && fraction <= 1)) {
+            return false;
+        }
+    }
+
+    const QuantileSketch* sketch = nullptr;
+    if (!_is_subset) {
+        sketch = _table.ColumnSketch(column);
+    } else {
+        std::lock_guard<std::mutex> guard(_cache->mutex);
+        auto it = _cache->sketches.find(column);
+        if (it == _cache->sketches.end()) {
+            QuantileSketch subset_sketch;
+            if (column->FillQuantileSketch(_subset_indices, true, subset_sketch)) {
+                it = _cache->sketches.emplace(column, std::move(subset_sketch)).first;
+            }
+        }
+        if (it != _cache->sketches.end()) {
+            sketch = &it->second;
+        }
+    }
+    if (!sketch) {
+        return false;
+    }
+
+    quantiles.resize(fractions.size());
+    for (size_t i = 0; i < fractions.size(); i++) {
+        quantiles[i] = sketch->Quantile(fractions[i]);
+    }
+    return true;
+}
+
+bool TableView::ClipByQuantiles(const Column* column, double lower_fraction, double upper_fraction, bool exact) {
+    std::vector<double> limits;
+    if (lower_fraction > upper_fraction || !Quantiles(column, {lower_fraction, upper_fraction}, limits, exact)) {
+        return false;
+    }
+    return NumericFilter(column, RANGE_INCLUSIVE, limits[0], limits[1]);
+}
+
+bool TableView::FillBatch(const std::vector<const Column*>& columns, int64_t start, int64_t end, RowBatch& batch, BatchLayout layout) const {
+    if (!ValidBatchColumns(columns)) {
+        return false;
+    }
+    ClampRange(start, end);
+
+    // The prefetched batch is only used if its rows are still the rows of the view, as the view may have been sorted since
+    std::future<RowBatch> prefetched;
+    {
+        std::lock_guard<std::mutex> guard(_cache->mutex);
+        auto& candidate = _cache->prefetched_batch;
+        if (candidate.batch.valid() && candidate.columns == columns && candidate.layout == layout && candidate.is_subset == _is_subset &&
+            candidate.start == start && candidate.end == end &&
+            std::equal(candidate.subset_indices.begin(), candidate.subset_indices.end(), _subset_indices.begin() + (_is_subset ? start : 0))) {
+            prefetched = std::move(candidate.batch);
+        }
+    }
+
+    if (prefetched.valid()) {
+        batch = prefetched.get();
+    } else {
+        PackBatch(columns, _subset_indices, _is_subset, start, end, layout, batch);
+    }
+    batch.start = start;
+    return true;
+}
+
+bool TableView::PrefetchBatch(const std::vector<const Column*>& columns, int64_t start, int64_t end, BatchLayout layout) const {
+    if (!ValidBatchColumns(columns)) {
+        return false;
+    }
+    ClampRange(start, end);
+
+    // The background task packs its own copy of the subset indices, so the view can be modified while it runs
+    PrefetchedBatch prefetch;
+    prefetch.columns = columns;
+    prefetch.layout = layout;
+    prefetch.is_subset = _is_subset;
+    prefetch.start = start;
+    prefetch.end = end;
+    if (_is_subset) {
+        prefetch.subset_indices.assign(_subset_indices.begin() + start, _subset_indices.begin() + end);
+    }
+    bool is_subset = _is_subset;
+    prefetch.batch = std::async(std::launch::async, [columns, indices = prefetch.subset_indices, is_subset, start, end, layout]() {
+        RowBatch batch;
+        if (is_subset) {
+            PackBatch(columns, indices, true, 0, end - start, layout, batch);
+        } else {
+            PackBatch(columns, IndexList(), false, start, end, layout, batch);
+        }
+        return batch;
+    });
+
+    // A replaced prefetch is destroyed outside the lock, as its destructor waits for it to finish
+    std::lock_guard<std::mutex> guard(_cache->mutex);
+    std::swap(_cache->prefetched_batch, prefetch);
+    return true;
+}
+
+bool TableView::ValidBatchColumns(const std::vector<const Column*>& columns) const {
+    for (auto column: columns) {
+        if (!column || column->data_type == UNKNOWN_TYPE || column->NumEntries() != _table.NumRows()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TableView::PackBatch(const std::vector<const Column*>& columns, const IndexList& indices, bool is_subset, int64_t start, int64_t end,
+    BatchLayout layout, RowBatch& batch) {
+    int64_t num_rows = end - start;
+    size_t num_columns = columns.size();
+    batch.layout = layout;
+    batch.num_rows = num_rows;
+    batch.entry_sizes.resize(num_columns);
+    batch.column_offsets.resize(num_columns);
+    batch.row_size = 0;
+    for (size_t i = 0; i < num_columns; i++) {
+        batch.entry_sizes[i] = columns[i]->BatchEntrySize(indices, is_subset, start, end);
+        batch.column_offsets[i] = layout == ROW_MAJOR ? batch.row_size : batch.row_size * num_rows;
+        batch.row_size += batch.entry_sizes[i];
+    }
+    batch.data.resize(batch.row_size * num_rows);
+
+    // Each thread packs all columns for its blocks of rows
+    int64_t num_blocks = (num_rows + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+#pragma omp parallel for schedule(static)
+    for (int64_t block = 0; block < num_blocks; block++) {
+        int64_t block_start = start + block * BATCH_BLOCK_SIZE;
+        int64_t block_end = std::min(block_start + BATCH_BLOCK_SIZE, end);
+        for (size_t i = 0; i < num_columns; i++) {
+            size_t stride = layout == ROW_MAJOR ? batch.row_size : batch.entry_sizes[i];
+            auto output = batch.data.data() + batch.column_offsets[i] + (block_start - start) * stride;
+            columns[i]->FillBatchEntries(indices, is_subset, block_start, block_end, output, stride, batch.entry_sizes[i]);
+        }
+    }
+}
+
+bool TableView::Density(const Column* x_column, const Column* y_column, int width, int height, DensityGrid& grid, double x_min,
+    double x_max, double y_min, double y_max) const {
+    if (!IsNumeric(x_column) || !IsNumeric(y_column) || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    // Missing limits span the full range of both columns, which is also spanned by the pyramid if it has been built
+    auto pyramid = FindDensityPyramid(x_column, y_column);
+    ColumnStatistics x_stats, y_stats;
+    if (pyramid) {
+        auto& base = pyramid->levels.front();
+        x_stats.min = base.x_min;
+        x_stats.max = base.x_max;
+        y_stats.min = base.y_min;
+        y_stats.max = base.y_max;
+    } else {
+        Aggregate(x_column, x_stats);
+        Aggregate(y_column, y_stats);
+    }
+    grid = DensityGrid();
+    grid.width = width;
+    grid.height = height;
+    grid.x_min = std::isnan(x_min) ? x_stats.min : x_min;
+    grid.x_max = std::isnan(x_max) ? x_stats.max : x_max;
+    grid.y_min = std::isnan(y_min) ? y_stats.min : y_min;
+    grid.y_max = std::isnan(y_max) ? y_stats.max : y_max;
+    grid.counts.assign(int64_t(width) * height, 0);
+    grid.rows.assign(int64_t(width) * height, -1);
+    if (std::isnan(x_stats.min) || std::isnan(y_stats.min) || !(grid.x_min <= grid.x_max && grid.y_min <= grid.y_max)) {
+        return true;
+    }
+
+    double grid_bin_width = (grid.x_max - grid.x_min) / width;
+    double grid_bin_height = (grid.y_max - grid.y_min) / height;
+    auto usable = [&](const DensityGrid& candidate) {
+        double bin_width = (candidate.x_max - candidate.x_min) / candidate.width;
+        double bin_height = (candidate.y_max - candidate.y_min) / candidate.height;
+        return grid_bin_width >= DENSITY_PYRAMID_OVERSAMPLING * bin_width && grid_bin_height >= DENSITY_PYRAMID_OVERSAMPLING * bin_height;
+    };
+
+    // The finest level has the smallest bins, so the pyramid is only built if its finest level could be used
+    if (!pyramid) {
+        DensityGrid base;
+        base.width = DENSITY_PYRAMID_SIZE;
+        base.height = DENSITY_PYRAMID_SIZE;
+        base.x_min = x_stats.min;
+        base.x_max = x_stats.max;
+        base.y_min = y_stats.min;
+        base.y_max = y_stats.max;
+        if (usable(base)) {
+            pyramid = BuildDensityPyramid(x_column, y_column, x_stats, y_stats);
+        }
+    }
+
+    // Use the coarsest pyramid level that is still sufficiently finer than the grid
+    const DensityGrid* level = nullptr;
+    if (pyramid) {
+        for (auto& candidate: pyramid->levels) {
+            if (usable(candidate)) {
+                level = &candidate;
+            }
+        }
+    }
+    if (!level) {
+        BinDensity(x_column, y_column, grid);
+        return true;
+    }
+
+    double level_bin_width = (level->x_max - level->x_min) / level->width;
+    double level_bin_height = (level->y_max - level->y_min) / level->height;
+    double x_scale = grid.x_max > grid.x_min ? width / (grid.x_max - grid.x_min) : 0;
+    double y_scale = grid.y_max > grid.y_min ? height / (grid.y_max - grid.y_min) : 0;
+    for (int j = 0; j < level->height; j++) {
+        double y = level->y_min + (j + 0.5) * level_bin_height;
+        if (y < grid.y_min || y > grid.y_max) {
+            continue;
+        }
+        int64_t grid_j = std::min(int((y - grid.y_min) * y_scale), height - 1);
+        for (int i = 0; i < level->width; i++) {
+            auto level_index = int64_t(j) * level->width + i;
+            double x = level->x_min + (i + 0.5) * level_bin_width;
+            if (!level->counts[level_index] || x < grid.x_min || x > grid.x_max) {
+                continue;
+            }
+            auto grid_index = grid_j * width + std::min(int((x - grid.x_min) * x_scale), width - 1);
+            grid.counts[grid_index] += level->counts[level_index];
+            auto row = level->rows[level_index];
+            if (grid.rows[grid_index] < 0 || row < grid.rows[grid_index]) {
+                grid.rows[grid_index] = row;
+            }
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const TableView::DensityPyramid> TableView::FindDensityPyramid(const Column* x_column, const Column* y_column) const {
+    std::lock_guard<std::mutex> guard(_cache->mutex);
+    for (auto& cached: _cache->density_pyramids) {
+        if (cached->x_column == x_column && cached->y_column == y_column) {
+            return cached;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const TableView::DensityPyramid> TableView::BuildDensityPyramid(const Column* x_column, const Column* y_column,
+    const ColumnStatistics& x_stats, const ColumnStatistics& y_stats) const {
+    auto pyramid = std::make_shared<DensityPyramid>();
+    pyramid->x_column = x_column;
+    pyramid->y_column = y_column;
+
+    DensityGrid base;
+    base.width = DENSITY_PYRAMID_SIZE;
+    base.height = DENSITY_PYRAMID_SIZE;
+    base.x_min = x_stats.min;
+    base.x_max = x_stats.max;
+    base.y_min = y_stats.min;
+    base.y_max = y_stats.max;
+    base.counts.assign(int64_t(base.width) * base.height, 0);
+    base.rows.assign(int64_t(base.width) * base.height, -1);
+    if (!std::isnan(base.x_min) && !std::isnan(base.y_min)) {
+        BinDensity(x_column, y_column, base);
+    }
+    pyramid->levels.push_back(std::move(base));
+
+    // Each level merges 2x2 blocks of bins of the previous level
+    while (pyramid->levels.back().width > 1 || pyramid->levels.back().height > 1) {
+        auto& previous = pyramid->levels.back();
+        DensityGrid level;
+        level.width = (previous.width + 1) / 2;
+        level.height = (previous.height + 1) / 2;
+        level.x_min = previous.x_min;
+        level.y_min = previous.y_min;
+        // Odd sizes are extended by half a bin, so that bins keep equal widths
+        level.x_max = previous.x_min + (previous.x_max - previous.x_min) * level.width * 2 / previous.width;
+        level.y_max = previous.y_min + (previous.y_max - previous.y_min) * level.height * 2 / previous.height;
+        level.counts.assign(int64_t(level.width) * level.height, 0);
+        level.rows.assign(int64_t(level.width) * level.height, -1);
+        for (int j = 0; j < previous.height; j++) {
+            for (int i = 0; i < previous.width; i++) {
+                auto previous_index = int64_t(j) * previous.width + i;
+                auto index = int64_t(j / 2) * level.width + i / 2;
+                level.counts[index] += previous.counts[previous_index];
+                auto row = previous.rows[previous_index];
+                if (row >= 0 && (level.rows[index] < 0 || row < level.rows[index])) {
+                    level.rows[index] = row;
+                }
+            }
+        }
+        pyramid->levels.push_back(std::move(level));
+    }
+
+    std::lock_guard<std::mutex> guard(_cache->mutex);
+    if (_cache->density_pyramids.size() >= DENSITY_PYRAMID_CACHE_SIZE) {
+        _cache->density_pyramids.erase(_cache->density_pyramids.begin());
+    }
+    _cache->density_pyramids.push_back(pyramid);
+    return pyramid;
+}
+
+void TableView::BinDensity(const Column* x_column, const Column* y_column, DensityGrid& grid) const {
+    int64_t num_rows = NumRows();
+    int64_t num_bins = int64_t(grid.width) * grid.height;
+    int64_t num_blocks = (num_rows + DENSITY_BLOCK_SIZE - 1) / DENSITY_BLOCK_SIZE;
+    double x_scale = grid.x_max > grid.x_min ? grid.width / (grid.x_max - grid.x_min) : 0;
+    double y_scale = grid.y_max > grid.y_min ? grid.height / (grid.y_max - grid.y_min) : 0;
+    double max_x_bin = grid.width - 1;
+    double max_y_bin = grid.height - 1;
+
+    // Each thread bins into its own grid, and the number of threads is limited so that the grids fit in the memory budget.
+    // A single thread bins into the output grid directly
+    size_t thread_grid_size = std::max(num_bins, int64_t(1)) * (sizeof(int64_t) + sizeof(int64_t));
+    int num_threads = std::clamp(int64_t(DENSITY_THREAD_GRID_MEMORY / thread_grid_size), int64_t(1), int64_t(MaxThreadCount()));
+    std::vector<std::vector<int64_t>> thread_counts(num_threads);
+    std::vector<IndexList> thread_rows(num_threads);
+#pragma omp parallel num_threads(num_threads)
+    {
+        int64_t* counts = grid.counts.data();
+        int64_t* rows = grid.rows.data();
+        if (num_threads > 1) {
+            thread_counts[ThreadIndex()].assign(num_bins, 0);
+            thread_rows[ThreadIndex()].assign(num_bins, -1);
+            counts = thread_counts[ThreadIndex()].data();
+            rows = thread_rows[ThreadIndex()].data();
+        }
+        std::vector<double> x_values(DENSITY_BLOCK_SIZE);
+        std::vector<double> y_values(DENSITY_BLOCK_SIZE);
+        std::vector<int64_t> bins(DENSITY_BLOCK_SIZE);
+
+#pragma omp for schedule(static)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * DENSITY_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + DENSITY_BLOCK_SIZE, num_rows);
+            int64_t num_values = FillValuesAs(x_column, x_values.data(), block_start, block_end);
+            FillValuesAs(y_column, y_values.data(), block_start, block_end);
+
+            // Bin indices are computed in a vectorizable pass, with -1 marking rows outside the grid
+#pragma omp simd
+            for (int64_t i = 0; i < num_values; i++) {
+                double x = x_values[i];
+                double y = y_values[i];
+                bool in_range = x >= grid.x_min && x <= grid.x_max && y >= grid.y_min && y <= grid.y_max;
+                int64_t x_bin = in_range ? std::min((x - grid.x_min) * x_scale, max_x_bin) : 0;
+                int64_t y_bin = in_range ? std::min((y - grid.y_min) * y_scale, max_y_bin) : 0;
+                bins[i] = in_range ? y_bin * grid.width + x_bin : -1;
+            }
+
+            for (int64_t i = 0; i < num_values; i++) {
+                auto bin = bins[i];
+                if (bin >= 0) {
+                    int64_t row = _is_subset ? _subset_indices[block_start + i] : block_start + i;
+                    counts[bin]++;
+                    if (rows[bin] < 0 || row < rows[bin]) {
+                        rows[bin] = row;
+                    }
+                }
+            }
+        }
+    }
+
+    if (num_threads == 1) {
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (int64_t bin = 0; bin < num_bins; bin++) {
+        for (size_t t = 0; t < thread_counts.size(); t++) {
+            if (thread_counts[t].empty() || !thread_counts[t][bin]) {
+                continue;
+            }
+            grid.counts[bin] += thread_counts[t][bin];
+            auto row = thread_rows[t][bin];
+            if (grid.rows[bin] < 0 || row < grid.rows[bin]) {
+                grid.rows[bin] = row;
+            }
+        }
+    }
+}
+
+GroupedView TableView::GroupBy(const Column* key_column) const {
+    return GroupedView(key_column, _subset_indices, _is_subset);
+}
+
+JoinedView TableView::Join(const Column* key_column, const TableView& other, const Column* other_key_column, JoinType join_type) const {
+    return JoinedView(*this, key_column, other, other_key_column, join_type);
+}
+
 size_t TableView::NumRows() const {
     if (_is_subset) {
         return _subset_indices.size();
     }
     return _table.NumRows();
 }
+void TableView::ClampRange(int64_t& start, int64_t& end) const {
+    int64_t num_rows = NumRows();
+    start = clamp(start, (int64_t) 0, num_rows);
+    if (end < 0) {
+        end = num_rows;
+    }
+    end = clamp(end, start, num_rows);
+}
+
+void TableView::InvalidateCache() {
+    _cache = std::make_shared<ViewCache>();
+}
+
+Bitmap TableView::IndicesToBitmap(const IndexList& indices, size_t num_rows) {
+    Bitmap bitmap((num_rows + 63) / 64, 0);
+    for (auto i: indices) {
+        if (i >= 0 && i < num_rows) {
+            bitmap[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    return bitmap;
+}
+
+IndexList TableView::BitmapToIndices(const Bitmap& bitmap, size_t num_rows) {
+    // Bits past the end of the table may be set by inverting the bitmap, and are masked out
+    auto word_at = [&](int64_t word_index) {
+        auto word = bitmap[word_index];
+        int64_t word_start = word_index * 64;
+        if (word_start + 64 > num_rows) {
+            word &= (uint64_t(1) << (num_rows - word_start)) - 1;
+        }
+        return word;
+    };
+
+    // Count set bits per chunk of words, so that each chunk can be extracted in parallel
+    int64_t num_words = bitmap.size();
+    int64_t chunk_size = 4096;
+    int64_t num_chunks = (num_words + chunk_size - 1) / chunk_size;
+    std::vector<int64_t> chunk_offsets(num_chunks + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int64_t chunk = 0; chunk < num_chunks; chunk++) {
+        int64_t count = 0;
+        for (int64_t i = chunk * chunk_size; i < std::min(num_words, (chunk + 1) * chunk_size); i++) {
+            count += __builtin_popcountll(word_at(i));
+        }
+        chunk_offsets[chunk + 1] = count;
+    }
+    std::partial_sum(chunk_offsets.begin(), chunk_offsets.end(), chunk_offsets.begin());
+
+    IndexList indices(chunk_offsets.back());
+#pragma omp parallel for schedule(static)
+    for (int64_t chunk = 0; chunk < num_chunks; chunk++) {
+        auto output = indices.data() + chunk_offsets[chunk];
+        for (int64_t i = chunk * chunk_size; i < std::min(num_words, (chunk + 1) * chunk_size); i++) {
+            auto word = word_at(i);
+            while (word) {
+                *output++ = i * 64 + __builtin_ctzll(word);
+                word &= word - 1;
+            }
+        }
+    }
+    return indices;
+}
+
+bool TableView::BitmapContains(const Bitmap& bitmap, int64_t index, size_t num_rows) {
+    return index >= 0 && index < num_rows && (bitmap[index / 64] >> (index % 64)) & 1;
+}
+
+void TableView::GallopingFilter(const IndexList& small_indices, const IndexList& large_indices, bool keep_members, IndexList& output) {
+    // For each index in the smaller list, gallop forward through the larger list using an exponential search
+    auto it = large_indices.begin();
+    auto end = large_indices.end();
+    for (auto i: small_indices) {
+        ptrdiff_t step = 1;
+        auto search_end = it;
+        while (search_end != end && *search_end < i) {
+            it = search_end;
+            search_end = (std::distance(search_end, end) > step) ? search_end + step : end;
+            step *= 2;
+        }
+        it = std::lower_bound(it, search_end, i);
+        bool is_member = it != end && *it == i;
+        if (is_member == keep_members) {
+            output.push_back(i);
+        }
+    }
+}
 }
\ No newline at end of file
@@ -1,12 +1,97 @@
 #ifndef VOTABLE_TEST__TABLEVIEW_H_
 #define VOTABLE_TEST__TABLEVIEW_H_
 
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "Table.h"
+#include "GroupedView.h"
+#include "Span.h"
+
+// Views are combined as bitmaps unless their combined size multiplied by this factor is less than the table's row count
+#define BITMAP_DENSITY_THRESHOLD 32
+// Intersections and differences use a galloping search when one view is larger than the other by this factor
+#define GALLOP_SIZE_RATIO 32
+// Number of histograms cached by each view, with the oldest histogram discarded first
+#define HISTOGRAM_CACHE_SIZE 8
+// Subsets with at least this many rows are gathered in parallel
+#define PARALLEL_GATHER_MIN_SIZE (64 * 1024)
+// Number of rows packed at a time by each thread when filling a batch
+#define BATCH_BLOCK_SIZE 4096
+// Number of rows binned at a time by each thread when computing a density grid
+#define DENSITY_BLOCK_SIZE 4096
+// Width and height of the finest level of cached density pyramids
+#define DENSITY_PYRAMID_SIZE 1024
+// Density grids are only computed from a pyramid level with at least this many of its bins per grid bin along each axis
+#define DENSITY_PYRAMID_OVERSAMPLING 8
+// Number of density pyramids cached by each view, with the oldest pyramid discarded first
+#define DENSITY_PYRAMID_CACHE_SIZE 4
+// Maximum memory of the per-thread grids used when binning density, which limits the number of threads binning large grids
+#define DENSITY_THREAD_GRID_MEMORY (size_t(256) * 1024 * 1024)
+// Number of rows tested together by region filters
+#define REGION_BLOCK_SIZE 4096
 
 namespace carta {
 
 class Table;
 
+typedef std::vector<uint64_t> Bitmap;
+
+enum CombinationOperator {
+    UNION = 0,
+    INTERSECTION = 1,
+    SYMMETRIC_DIFFERENCE = 2,
+    DIFFERENCE = 3
+};
+
+enum JoinType {
+    INNER_JOIN = 0,
+    LEFT_JOIN = 1
+};
+
+enum BatchLayout {
+    ROW_MAJOR = 0,
+    COLUMN_MAJOR = 1
+};
+
+// Packed binary copy of a window of rows of a view. Row-major batches store the entries of each row contiguously, while
+// column-major batches store the entries of each column contiguously. Numeric entries are stored in native byte order,
+// and strings as fixed-width fields padded with nulls
+struct RowBatch {
+    BatchLayout layout = ROW_MAJOR;
+    int64_t start = 0;
+    int64_t num_rows = 0;
+    // Width of each column's entries, and the offset of each column within a row (row-major) or within the data (column-major)
+    std::vector<size_t> entry_sizes;
+    std::vector<size_t> column_offsets;
+    size_t row_size = 0;
+    std::vector<uint8_t> data;
+};
+
+// Counts of the rows of a view in a grid of bins spanning [x_min, x_max] and [y_min, y_max] of two columns. Bins are
+// stored in row-major order, with x varying fastest
+struct DensityGrid {
+    int width = 0;
+    int height = 0;
+    double x_min = NAN;
+    double x_max = NAN;
+    double y_min = NAN;
+    double y_max = NAN;
+    std::vector<int64_t> counts;
+    // Lowest row index in each bin, or -1 for empty bins
+    IndexList rows;
+};
+
+// Column and direction of one of the keys of a multi-column sort
+struct SortColumn {
+    const Column* column;
+    bool ascending = true;
+};
+
+class JoinedView;
+
 class TableView {
 public:
     TableView(const Table& table);
@@ -16,28 +101,166 @@ public:
     bool NumericFilter(const Column* column, ComparisonOperator comparison_operator, double value, double secondary_value = 0.0);
     bool StringFilter(const Column* column, std::string search_string, bool case_insensitive = false);
 
+    // Sky position filters, using a spatial index of the RA and Dec columns cached by the table. Positions are in degrees
+    bool ConeFilter(const Column* ra_column, const Column* dec_column, double ra, double dec, double radius);
+    // RA limits wrap around 360 degrees if ra_min is greater than ra_max
+    bool SkyBoxFilter(const Column* ra_column, const Column* dec_column, double ra_min, double ra_max, double dec_min, double dec_max);
+    // Polygon vertices are joined by great circles, and the polygon must lie within a hemisphere
+    bool SkyPolygonFilter(const Column* ra_column, const Column* dec_column, const std::vector<double>& ra, const std::vector<double>& dec);
+    // Planar region filters over the entries of any two numeric columns, keeping the existing order of the view. Rows with
+    // NaN entries are removed
+    bool PolygonFilter(const Column* x_column, const Column* y_column, const std::vector<double>& polygon_x, const std::vector<double>& polygon_y);
+    // The ellipse is rotated anticlockwise by the given angle in degrees, measured from the x axis to the major axis
+    bool EllipseFilter(const Column* x_column, const Column* y_column, double x_centre, double y_centre, double semi_major,
+        double semi_minor, double angle = 0.0);
+
     bool Invert();
     void Reset();
-    bool Combine(const TableView& second);
+    // Combines with a second view of the same table. Intersections and differences preserve the order of an unordered
+    // first view, while all other combinations result in a view ordered by index
+    bool Combine(const TableView& second, CombinationOperator combination_operator = UNION);
 
     // Sorting
     bool SortByColumn(const Column* column, bool ascending = true);
+    // Sorts by each of the columns in turn, with later columns used to order rows with equal values in earlier columns.
+    // The sort is stable, so rows with equal values in all columns keep their order
+    bool SortByColumns(const std::vector<SortColumn>& sort_columns);
+    // Sorts only the rows that belong in positions [start, end) of the sorted view, with a negative end referring to the
+    // last row. Other rows are left unordered
+    bool PartialSortByColumn(const Column* column, int64_t start, int64_t end, bool ascending = true);
+    // Reduces the view to the first num_rows rows of the sorted view, in sorted order
+    bool TopByColumn(const Column* column, int64_t num_rows, bool ascending = true);
     bool SortByIndex();
 
+    // Aggregation
+    bool Aggregate(const Column* column, ColumnStatistics& stats) const;
+    // Bins the column's entries into num_bins bins. If either range limit is NaN, it is determined from the entries.
+    // Results are cached until the rows of the view change
+    bool Histogram(const Column* column, int num_bins, ColumnHistogram& histogram, bool log_scale = false, double min_val = NAN,
+        double max_val = NAN) const;
+    // Values below which the given fractions of the column's valid entries lie. Approximate quantiles use a sketch of the
+    // column, cached by the table for full views and by the view otherwise. Exact quantiles interpolate between entries
+    bool Quantiles(const Column* column, const std::vector<double>& fractions, std::vector<double>& quantiles, bool exact = false) const;
+    // Removes rows with entries outside the range between the given quantiles of the column, or with NaN entries
+    bool ClipByQuantiles(const Column* column, double lower_fraction, double upper_fraction, bool exact = false);
+    // Bins the rows of the view by the entries of two numeric columns, with NaN limits determined from the entries. Grids
+    // that are coarse enough are re-binned from a cached multi-resolution pyramid, assigning each pyramid bin to the grid
+    // bin containing its centre. The pyramid is only built when the grid is coarse enough to use it. Finer grids are
+    // binned directly from the entries
+    bool Density(const Column* x_column, const Column* y_column, int width, int height, DensityGrid& grid, double x_min = NAN,
+        double x_max = NAN, double y_min = NAN, double y_max = NAN) const;
+    // Groups the rows of the view by the distinct entries of the key column
+    GroupedView GroupBy(const Column* key_column) const;
+    // Hash join with a view of another table, pairing rows with equal entries in integer or string key columns. Unsigned
+    // 64-bit keys cannot be joined with signed keys
+    JoinedView Join(const Column* key_column, const TableView& other, const Column* other_key_column, JoinType join_type = INNER_JOIN) const;
+
     // Retrieving data
     size_t NumRows() const;
     template<class T>
     std::vector<T> Values(const Column* column, int64_t start = -1, int64_t end = -1) const;
+    // Entries of the rows [start, end) of a full view, without copying. Empty for subsets, which are not contiguous, and
+    // for compressed columns. Not available for boolean columns
+    template<class T>
+    Span<const T> ValuesSpan(const Column* column, int64_t start = -1, int64_t end = -1) const;
+    // Copies the entries of the rows [start, end) of the view into a caller-provided buffer, which must be large enough
+    // to hold them. Returns the number of entries copied. Not available for boolean columns
+    template<class T>
+    size_t FillValues(const Column* column, T* buffer, int64_t start = -1, int64_t end = -1) const;
+    // As Values and FillValues, but converting the entries of any numeric column to the requested numeric type, which
+    // cannot be bool
+    template<class OutT>
+    std::vector<OutT> ValuesAs(const Column* column, int64_t start = -1, int64_t end = -1) const;
+    template<class OutT>
+    size_t FillValuesAs(const Column* column, OutT* buffer, int64_t start = -1, int64_t end = -1) const;
+    // Packs the entries of the columns for rows [start, end) of the view into a batch. If a batch with the same rows and
+    // columns has been prefetched, it is used instead
+    bool FillBatch(const std::vector<const Column*>& columns, int64_t start, int64_t end, RowBatch& batch, BatchLayout layout = ROW_MAJOR) const;
+    // Starts packing a batch in the background, to be collected by a later call to FillBatch. Only the latest prefetched
+    // batch is kept
+    bool PrefetchBatch(const std::vector<const Column*>& columns, int64_t start, int64_t end, BatchLayout layout = ROW_MAJOR) const;
 
 protected:
+    friend class JoinedView;
+
+    struct CachedHistogram {
+        const Column* column;
+        int num_bins;
+        bool log_scale;
+        double min_val;
+        double max_val;
+        ColumnHistogram histogram;
+    };
+
+    // Density grids over the full range of two columns, each level with half the resolution of the previous level
+    struct DensityPyramid {
+        const Column* x_column;
+        const Column* y_column;
+        std::vector<DensityGrid> levels;
+    };
+
+    struct PrefetchedBatch {
+        std::vector<const Column*> columns;
+        BatchLayout layout;
+        bool is_subset;
+        int64_t start;
+        int64_t end;
+        IndexList subset_indices;
+        std::future<RowBatch> batch;
+    };
+
+    // Results that depend only on the set of rows in the view. Copies of a view share the cache until either is modified
+    struct ViewCache {
+        std::mutex mutex;
+        std::vector<CachedHistogram> histograms;
+        std::unordered_map<const Column*, QuantileSketch> sketches;
+        std::vector<std::shared_ptr<const DensityPyramid>> density_pyramids;
+        PrefetchedBatch prefetched_batch;
+    };
+
+    void InvalidateCache();
+    // Clamps [start, end) to the rows of the view, with a negative end referring to the last row
+    void ClampRange(int64_t& start, int64_t& end) const;
+    // Cached pyramid of two columns, or nullptr if there is none
+    std::shared_ptr<const DensityPyramid> FindDensityPyramid(const Column* x_column, const Column* y_column) const;
+    // Builds and caches a pyramid spanning the given statistics of two columns
+    std::shared_ptr<const DensityPyramid> BuildDensityPyramid(const Column* x_column, const Column* y_column,
+        const ColumnStatistics& x_stats, const ColumnStatistics& y_stats) const;
+    // Bins the rows of the view into a grid with its size and limits already set
+    void BinDensity(const Column* x_column, const Column* y_column, DensityGrid& grid) const;
+    bool ValidBatchColumns(const std::vector<const Column*>& columns) const;
+    // Packs positions [start, end) of the indices, or rows [start, end) if is_subset is false
+    static void PackBatch(const std::vector<const Column*>& columns, const IndexList& indices, bool is_subset, int64_t start, int64_t end,
+        BatchLayout layout, RowBatch& batch);
+    template<class InT, class OutT>
+    size_t ConvertValues(const DataColumn<InT>* column, OutT* buffer, int64_t start, int64_t end) const;
+    // Calls func(values, offset, num_values) in parallel on blocks of the decoded entries of a compressed column, for
+    // positions [start, end) of the view
+    template<class T, class F>
+    void ForEachDecodedBlock(const DataColumn<T>* column, int64_t start, int64_t end, F func) const;
+    // Keeps the rows for which test(x, y, num_values, keep) sets keep to a non-zero value, testing blocks of entries in parallel
+    template<class RegionTest>
+    bool RegionFilter(const Column* x_column, const Column* y_column, RegionTest test);
+    static bool IsNumeric(const Column* column);
+    // Keeps only the rows in an ascending list of rows
+    bool IntersectRows(const IndexList& rows);
+    bool SortSubsetFromIndex(const Column* column, bool ascending);
+    static double SortCost(size_t num_indices);
+    static Bitmap IndicesToBitmap(const IndexList& indices, size_t num_rows);
+    static IndexList BitmapToIndices(const Bitmap& bitmap, size_t num_rows);
+    static bool BitmapContains(const Bitmap& bitmap, int64_t index, size_t num_rows);
+    static void GallopingFilter(const IndexList& small_indices, const IndexList& large_indices, bool keep_members, IndexList& output);
+
     bool _is_subset;
     bool _ordered;
     IndexList _subset_indices;
     const Table& _table;
+    std::shared_ptr<ViewCache> _cache;
 
 };
 }
 
 #include "TableView.tcc"
+#include "JoinedView.h"
 
 #endif //VOTABLE_TEST__TABLEVIEW_H_
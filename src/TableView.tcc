@@ -10,43 +10,231 @@ T clamp(T val, const T& min_val, const T& max_val) {
     return val;
 }
 
+// Converts a numeric value to another numeric type. Conversions from floating-point to integer types saturate at the
+// limits of the integer type, and convert NaNs to zero
+template<class OutT, class InT>
+inline OutT ConvertValue(InT val) {
+    if constexpr (std::is_floating_point_v<InT> && std::is_integral_v<OutT>) {
+        constexpr InT lowest = std::numeric_limits<OutT>::lowest();
+        constexpr InT max = std::numeric_limits<OutT>::max();
+        return val == val ? (val <= lowest ? std::numeric_limits<OutT>::lowest() :
+                            (val >= max ? std::numeric_limits<OutT>::max() : OutT(val))) : OutT(0);
+    } else {
+        return OutT(val);
+    }
+}
+
 template<class T>
 std::vector<T> TableView::Values(const Column* column, int64_t start, int64_t end) const {
     auto data_column = DataColumn<T>::TryCast(column);
-    if (!data_column || data_column->entries.empty()) {
+    if (!data_column || !data_column->NumEntries()) {
         return std::vector<T>();
     }
 
-    if (_is_subset) {
-        int64_t N = _subset_indices.size();
-        int64_t begin_index = clamp(start, (int64_t) 0, N);
-        if (end < 0) {
-            end = _subset_indices.size();
+    ClampRange(start, end);
+    // Boolean entries are packed into bits, so they are gathered one at a time rather than copied through a buffer
+    if constexpr (std::is_same_v<T, bool>) {
+        auto& entries = data_column->entries;
+        int64_t num_entries = entries.size();
+        std::vector<bool> values;
+        values.reserve(end - start);
+        for (auto i = start; i < end; i++) {
+            int64_t row = _is_subset ? _subset_indices[i] : i;
+            if (row >= 0 && row < num_entries) {
+                values.push_back(entries[row]);
+            }
         }
-        int64_t end_index = clamp(end, begin_index, N);
+        return values;
+    } else {
+        std::vector<T> values(end - start);
+        values.resize(FillValues(column, values.data(), start, end));
+        return values;
+    }
+}
 
-        auto begin_it = _subset_indices.begin() + begin_index;
-        auto end_it = _subset_indices.begin() + end_index;
-        std::vector<T> values;
-        values.reserve(std::distance(begin_it, end_it));
+template<class T>
+Span<const T> TableView::ValuesSpan(const Column* column, int64_t start, int64_t end) const {
+    static_assert(!std::is_same_v<T, bool>, "Boolean entries are packed into bits and cannot be viewed as a span");
+    auto data_column = DataColumn<T>::TryCast(column);
+    if (_is_subset || !data_column || data_column->entries.size() != NumRows()) {
+        return Span<const T>();
+    }
 
-        auto& entries = data_column->entries;
-        for (auto it = begin_it; it != end_it; it++) {
-            values.push_back(entries[*it]);
+    ClampRange(start, end);
+    return Span<const T>(data_column->entries.data() + start, end - start);
+}
+
+template<class T>
+size_t TableView::FillValues(const Column* column, T* buffer, int64_t start, int64_t end) const {
+    static_assert(!std::is_same_v<T, bool>, "Boolean entries are packed into bits and cannot be copied to a buffer");
+    auto data_column = DataColumn<T>::TryCast(column);
+    if (!data_column || !buffer) {
+        return 0;
+    }
+
+    ClampRange(start, end);
+    auto& entries = data_column->entries;
+    int64_t num_values = end - start;
+    if (data_column->IsCompressed()) {
+        if constexpr (PackedEntries<T>::packable) {
+            ForEachDecodedBlock(data_column, start, end, [&](const T* values, int64_t offset, int64_t num_decoded) {
+                std::copy(values, values + num_decoded, buffer + offset);
+            });
+        }
+    } else if (_is_subset) {
+        auto indices = _subset_indices.data() + start;
+#pragma omp parallel for schedule(static) if (num_values >= PARALLEL_GATHER_MIN_SIZE)
+        for (int64_t i = 0; i < num_values; i++) {
+            buffer[i] = entries[indices[i]];
+        }
+    } else {
+        end = std::min(end, (int64_t) entries.size());
+        start = std::min(start, end);
+        num_values = end - start;
+        std::copy(entries.begin() + start, entries.begin() + end, buffer);
+    }
+    return num_values;
+}
+
+template<class OutT>
+std::vector<OutT> TableView::ValuesAs(const Column* column, int64_t start, int64_t end) const {
+    static_assert(std::is_arithmetic_v<OutT> && !std::is_same_v<OutT, bool>, "Values can only be converted to non-boolean numeric types");
+    if (!column || !column->NumEntries()) {
+        return std::vector<OutT>();
+    }
+
+    ClampRange(start, end);
+    std::vector<OutT> values(end - start);
+    values.resize(FillValuesAs(column, values.data(), start, end));
+    return values;
+}
+
+template<class OutT>
+size_t TableView::FillValuesAs(const Column* column, OutT* buffer, int64_t start, int64_t end) const {
+    static_assert(std::is_arithmetic_v<OutT> && !std::is_same_v<OutT, bool>, "Values can only be converted to non-boolean numeric types");
+    if (!column || !buffer) {
+        return 0;
+    }
+
+    ClampRange(start, end);
+    switch (column->data_type) {
+        case UINT8: return ConvertValues(DataColumn<uint8_t>::TryCast(column), buffer, start, end);
+        case INT8: return ConvertValues(DataColumn<int8_t>::TryCast(column), buffer, start, end);
+        case UINT16: return ConvertValues(DataColumn<uint16_t>::TryCast(column), buffer, start, end);
+        case INT16: return ConvertValues(DataColumn<int16_t>::TryCast(column), buffer, start, end);
+        case UINT32: return ConvertValues(DataColumn<uint32_t>::TryCast(column), buffer, start, end);
+        case INT32: return ConvertValues(DataColumn<int32_t>::TryCast(column), buffer, start, end);
+        case UINT64: return ConvertValues(DataColumn<uint64_t>::TryCast(column), buffer, start, end);
+        case INT64: return ConvertValues(DataColumn<int64_t>::TryCast(column), buffer, start, end);
+        case FLOAT: return ConvertValues(DataColumn<float>::TryCast(column), buffer, start, end);
+        case DOUBLE: return ConvertValues(DataColumn<double>::TryCast(column), buffer, start, end);
+        default: return 0;
+    }
+}
+
+template<class InT, class OutT>
+size_t TableView::ConvertValues(const DataColumn<InT>* column, OutT* buffer, int64_t start, int64_t end) const {
+    if (!column) {
+        return 0;
+    }
+
+    // Entries are gathered and converted in a single pass, with simple loops that the compiler can vectorize
+    auto entries = column->entries.data();
+    int64_t num_values = end - start;
+    if (column->IsCompressed()) {
+        if constexpr (PackedEntries<InT>::packable) {
+            ForEachDecodedBlock(column, start, end, [&](const InT* values, int64_t offset, int64_t num_decoded) {
+                for (int64_t i = 0; i < num_decoded; i++) {
+                    buffer[offset + i] = ConvertValue<OutT>(values[i]);
+                }
+            });
+        }
+    } else if (_is_subset) {
+        auto indices = _subset_indices.data() + start;
+#pragma omp parallel for simd schedule(static) if (num_values >= PARALLEL_GATHER_MIN_SIZE)
+        for (int64_t i = 0; i < num_values; i++) {
+            buffer[i] = ConvertValue<OutT>(entries[indices[i]]);
         }
-        return values;
     } else {
-        int64_t N = data_column->entries.size();
-        int64_t begin_index = clamp(start, (int64_t) 0, N);
-        if (end < 0) {
-            end = N;
+        end = std::min(end, (int64_t) column->entries.size());
+        num_values = std::max(end - start, (int64_t) 0);
+        entries += start;
+#pragma omp parallel for simd schedule(static) if (num_values >= PARALLEL_GATHER_MIN_SIZE)
+        for (int64_t i = 0; i < num_values; i++) {
+            buffer[i] = ConvertValue<OutT>(entries[i]);
         }
-        int64_t end_index = clamp(end, begin_index, N);
+    }
+    return num_values;
+}
 
-        auto begin_it = data_column->entries.begin() + begin_index;
-        auto end_it = data_column->entries.begin() + end_index;
-        return std::vector<T>(begin_it, end_it);
+template<class T, class F>
+void TableView::ForEachDecodedBlock(const DataColumn<T>* column, int64_t start, int64_t end, F func) const {
+    int64_t num_values = end - start;
+#pragma omp parallel if (num_values >= PARALLEL_GATHER_MIN_SIZE)
+    {
+        std::vector<T> decoded(PACKED_BLOCK_SIZE);
+#pragma omp for schedule(static)
+        for (int64_t offset = 0; offset < num_values; offset += PACKED_BLOCK_SIZE) {
+            int64_t num_decoded = std::min(PACKED_BLOCK_SIZE, num_values - offset);
+            if (_is_subset) {
+                column->GatherEntries(_subset_indices.data() + start + offset, num_decoded, decoded.data());
+            } else {
+                column->CopyEntries(start + offset, start + offset + num_decoded, decoded.data());
+            }
+            func(decoded.data(), offset, num_decoded);
+        }
+    }
+}
+
+template<class RegionTest>
+bool TableView::RegionFilter(const Column* x_column, const Column* y_column, RegionTest test) {
+    InvalidateCache();
+    if (!IsNumeric(x_column) || !IsNumeric(y_column)) {
+        return false;
+    }
+
+    // Matching rows are collected per block, so that concatenating the blocks keeps the order of the view
+    int64_t num_rows = NumRows();
+    int64_t num_blocks = (num_rows + REGION_BLOCK_SIZE - 1) / REGION_BLOCK_SIZE;
+    std::vector<IndexList> block_rows(num_blocks);
+#pragma omp parallel
+    {
+        std::vector<double> x_values(REGION_BLOCK_SIZE);
+        std::vector<double> y_values(REGION_BLOCK_SIZE);
+        std::vector<uint8_t> keep(REGION_BLOCK_SIZE);
+
+#pragma omp for schedule(dynamic)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            int64_t block_start = block * REGION_BLOCK_SIZE;
+            int64_t block_end = std::min(block_start + REGION_BLOCK_SIZE, num_rows);
+            int64_t num_values = std::min(FillValuesAs(x_column, x_values.data(), block_start, block_end),
+                FillValuesAs(y_column, y_values.data(), block_start, block_end));
+            test(x_values.data(), y_values.data(), num_values, keep.data());
+
+            auto& rows = block_rows[block];
+            for (int64_t i = 0; i < num_values; i++) {
+                if (keep[i]) {
+                    rows.push_back(_is_subset ? _subset_indices[block_start + i] : block_start + i);
+                }
+            }
+        }
+    }
+
+    size_t num_matching = 0;
+    for (auto& rows: block_rows) {
+        num_matching += rows.size();
+    }
+    if (!_is_subset && num_matching == num_rows) {
+        return true;
+    }
+    IndexList matching_rows;
+    matching_rows.reserve(num_matching);
+    for (auto& rows: block_rows) {
+        matching_rows.insert(matching_rows.end(), rows.begin(), rows.end());
     }
+    _subset_indices.swap(matching_rows);
+    _is_subset = true;
+    return true;
 }
 
 }
@@ -1,5 +1,4 @@
 #include <chrono>
-#include <numeric>
 
 #include <fmt/format.h>
 #include "Table.h"
@@ -27,33 +26,19 @@ int main(int argc, char* argv[]) {
         auto first_column = table[column_to_sum];
         auto second_column = table[column_to_sum2];
         if (first_column && second_column) {
-            auto float_column = DataColumn<float>::TryCast(first_column);
-            auto double_column = DataColumn<double>::TryCast(first_column);
-            double sum_first;
-            if (float_column) {
-                sum_first = accumulate(float_column->entries.begin(), float_column->entries.end(), 0.0);
-            } else if (double_column) {
-                sum_first = accumulate(double_column->entries.begin(), double_column->entries.end(), 0.0);
-            } else {
-                fmt::print("Column with name \"{}\" is not a floating-point type!\n", column_to_sum);
+            ColumnStatistics first_stats, second_stats;
+            auto full_table = table.View();
+            if (!full_table.Aggregate(first_column, first_stats)) {
+                fmt::print("Column with name \"{}\" is not a numeric type!\n", column_to_sum);
                 return 1;
             }
-
-            auto float_column2 = DataColumn<float>::TryCast(second_column);
-            auto double_column2 = DataColumn<double>::TryCast(second_column);
-            double sum_second = 0;
-
-            if (float_column2) {
-                sum_second = accumulate(float_column2->entries.begin(), float_column2->entries.end(), 0.0);
-            } else if (double_column2) {
-                sum_second = accumulate(double_column2->entries.begin(), double_column2->entries.end(), 0.0);
-            } else {
-                fmt::print("Column with name \"{}\" is not a floating-point type!\n", column_to_sum2);
+            if (!full_table.Aggregate(second_column, second_stats)) {
+                fmt::print("Column with name \"{}\" is not a numeric type!\n", column_to_sum2);
                 return 1;
             }
 
-            double mean = sum_first / table.NumRows();
-            double mean2 = sum_second / table.NumRows();
+            double mean = first_stats.mean;
+            double mean2 = second_stats.mean;
 
             auto t_start_filter = chrono::high_resolution_clock::now();
             auto filtered_table = table.View();
@@ -66,12 +51,9 @@ int main(int argc, char* argv[]) {
             double test_val = NAN;
             auto t_start_sort = chrono::high_resolution_clock::now();
             if (num_matches) {
-                filtered_table.SortByColumn(first_column, false);
-                if (double_column) {
-                    test_val = filtered_table.Values<double>(double_column, 0, 1)[0];
-                } else {
-                    test_val = filtered_table.Values<float>(float_column, 0, 1)[0];
-                }
+                // Only the highest value is needed, so there is no need to sort the entire view
+                filtered_table.TopByColumn(first_column, 1, false);
+                test_val = filtered_table.ValuesAs<double>(first_column, 0, 1)[0];
             }
 
             auto t_end_sort = chrono::high_resolution_clock::now();
@@ -108,7 +90,7 @@ int main(int argc, char* argv[]) {
             fmt::print("{} entries with \"{}\" >= {:.3f} && \"{}\" >= {:.3f}\n",
                        num_matches, first_column->name, mean, second_column->name, mean2);
             fmt::print("Filtering done in {:.2f} ms\n", dt_filter);
-            fmt::print("Sorting of {} entries by \"{}\" done in {:.2f} ms. Highest value: {:.3f}\n", num_matches, first_column->name, dt_sort, test_val);
+            fmt::print("Highest value of \"{}\" among {} entries found in {:.2f} ms: {:.3f}\n", first_column->name, num_matches, dt_sort, test_val);
         } else {
             fmt::print("Column with name \"{}\" not found!\n", column_to_sum);
         }
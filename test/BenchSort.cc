@@ -0,0 +1,74 @@
+#include <chrono>
+#include <numeric>
+#include <random>
+
+#include <fmt/format.h>
+#include "Table.h"
+#include "DataColumn.tcc"
+
+using namespace std;
+using namespace carta;
+
+// Compares the comparison-based sort used previously by SortIndices with the current implementation, for each data type
+template<class T>
+void BenchmarkSort(const string& type_name, size_t num_rows, mt19937_64& generator) {
+    DataColumn<T> column(type_name);
+    column.Resize(num_rows);
+    for (auto& entry: column.entries) {
+        if constexpr (is_same_v<T, string>) {
+            entry = fmt::format("J{:010d}", generator() % 10000000000);
+        } else if constexpr (is_floating_point_v<T>) {
+            entry = uniform_real_distribution<T>(-1.0e6, 1.0e6)(generator);
+        } else {
+            entry = generator();
+        }
+    }
+
+    IndexList comparison_indices(num_rows);
+    iota(comparison_indices.begin(), comparison_indices.end(), 0);
+    IndexList indices = comparison_indices;
+    auto& entries = column.entries;
+
+    auto t_start = chrono::high_resolution_clock::now();
+    sort(comparison_indices.begin(), comparison_indices.end(), [&](int64_t a, int64_t b) {
+        return entries[a] < entries[b];
+    });
+    auto t_end = chrono::high_resolution_clock::now();
+    double dt_comparison = 1.0e-3 * chrono::duration_cast<chrono::microseconds>(t_end - t_start).count();
+
+    t_start = chrono::high_resolution_clock::now();
+    column.SortIndices(indices, true);
+    t_end = chrono::high_resolution_clock::now();
+    double dt_sort = 1.0e-3 * chrono::duration_cast<chrono::microseconds>(t_end - t_start).count();
+
+    // Both sorts must give the same order of values, although equal values may be in a different order
+    bool matching = true;
+    for (size_t i = 0; i < num_rows; i++) {
+        if (entries[indices[i]] != entries[comparison_indices[i]]) {
+            matching = false;
+            break;
+        }
+    }
+
+    fmt::print("{:>8}: comparison sort {:9.2f} ms; SortIndices {:9.2f} ms; speedup {:6.2f}x{}\n",
+               type_name, dt_comparison, dt_sort, dt_comparison / dt_sort, matching ? "" : " (MISMATCH)");
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_rows = argc > 1 ? stoull(argv[1]) : 10000000;
+    mt19937_64 generator(0);
+
+    fmt::print("Sorting {} rows\n", num_rows);
+    BenchmarkSort<uint8_t>("uint8", num_rows, generator);
+    BenchmarkSort<int8_t>("int8", num_rows, generator);
+    BenchmarkSort<uint16_t>("uint16", num_rows, generator);
+    BenchmarkSort<int16_t>("int16", num_rows, generator);
+    BenchmarkSort<uint32_t>("uint32", num_rows, generator);
+    BenchmarkSort<int32_t>("int32", num_rows, generator);
+    BenchmarkSort<uint64_t>("uint64", num_rows, generator);
+    BenchmarkSort<int64_t>("int64", num_rows, generator);
+    BenchmarkSort<float>("float", num_rows, generator);
+    BenchmarkSort<double>("double", num_rows, generator);
+    BenchmarkSort<string>("string", num_rows, generator);
+    return 0;
+}
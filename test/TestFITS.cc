@@ -1,7 +1,13 @@
 #include <gtest/gtest.h>
 #include <fmt/format.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <numeric>
 
 #include "Table.h"
+#include "TableCache.h"
+#include "DataColumn.tcc"
 
 using namespace std;
 using namespace carta;
@@ -23,6 +29,16 @@ TEST(BasicParsing, ParseIvoaExample) {
     EXPECT_EQ(table.NumRows(), 3);
 }
 
+TEST(BasicParsing, FailOnTruncatedData) {
+    // The header is intact, but the table data ends partway through the first row
+    auto truncated_path = (filesystem::temp_directory_path() / "ivoa_example_truncated.fits").string();
+    filesystem::copy_file(test_path("ivoa_example.fits"), truncated_path, filesystem::copy_options::overwrite_existing);
+    filesystem::resize_file(truncated_path, 3 * 2880 + 10);
+    Table table(truncated_path);
+    EXPECT_FALSE(table.IsValid());
+    filesystem::remove(truncated_path);
+}
+
 TEST(ParsedTable, CorrectFieldCount) {
     Table table(test_path("ivoa_example.fits"));
     EXPECT_TRUE(table.IsValid());
@@ -120,6 +136,209 @@ TEST(ParsedTable, CorrectDataValues) {
     EXPECT_EQ(col5_vals[1], 6);
 }
 
+TEST(ParsedTable, LoadFromColumnCache) {
+    // Work on a copy of the file, so that the cache is not written next to the test data
+    auto source_path = (filesystem::temp_directory_path() / "ivoa_example_cache.fits").string();
+    auto cache_path = source_path + TABLE_CACHE_SUFFIX;
+    filesystem::copy_file(test_path("ivoa_example.fits"), source_path, filesystem::copy_options::overwrite_existing);
+    filesystem::remove(cache_path);
+
+    Table parsed_table(source_path, false, true);
+    ASSERT_TRUE(parsed_table.IsValid());
+    EXPECT_TRUE(filesystem::exists(cache_path));
+
+    Table cached_table(source_path, false, true);
+    ASSERT_TRUE(cached_table.IsValid());
+    EXPECT_EQ(cached_table.NumRows(), 3);
+    EXPECT_EQ(cached_table.NumColumns(), parsed_table.NumColumns());
+    for (size_t i = 0; i < parsed_table.NumColumns(); i++) {
+        EXPECT_EQ(cached_table[i]->name, parsed_table[i]->name);
+        EXPECT_EQ(cached_table[i]->unit, parsed_table[i]->unit);
+        EXPECT_EQ(cached_table[i]->data_type, parsed_table[i]->data_type);
+        EXPECT_EQ(cached_table[i]->data_type_size, parsed_table[i]->data_type_size);
+    }
+    auto view = cached_table.View();
+    EXPECT_EQ(view.Values<string>(cached_table["Name"]), std::vector<string>({"N 224", "N 6744", "N 598"}));
+    EXPECT_EQ(view.Values<int16_t>(cached_table["e_RVel"]), std::vector<int16_t>({5, 6, 3}));
+    EXPECT_TRUE(view.NumericFilter(cached_table["RVel"], GREATER, 0));
+    EXPECT_EQ(view.NumRows(), 1);
+
+    filesystem::remove(cache_path);
+    filesystem::remove(source_path);
+}
+
+TEST(ParsedTable, ValidateColumnCache) {
+    auto source_path = (filesystem::temp_directory_path() / "ivoa_example_validation.fits").string();
+    auto cache_path = source_path + TABLE_CACHE_SUFFIX;
+    filesystem::copy_file(test_path("ivoa_example.fits"), source_path, filesystem::copy_options::overwrite_existing);
+    filesystem::remove(cache_path);
+    auto first_name = [](const Table& table) {
+        auto names = table.View().Values<string>(table["Name"]);
+        return names.empty() ? string() : names.front();
+    };
+    ASSERT_TRUE(Table(source_path, false, true).IsValid());
+    ASSERT_TRUE(filesystem::exists(cache_path));
+
+    // A source edited without changing its size or modification time is still loaded from the cache
+    auto source_time = filesystem::last_write_time(source_path);
+    {
+        fstream file(source_path, ios::in | ios::out | ios::binary);
+        string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        auto position = contents.find("N 224");
+        ASSERT_NE(position, string::npos);
+        file.clear();
+        file.seekp(position);
+        file.write("N 999", 5);
+    }
+    filesystem::last_write_time(source_path, source_time);
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 224");
+    EXPECT_EQ(first_name(Table(source_path)), "N 999");
+
+    // A changed modification time invalidates the cache, which is rewritten after parsing the source
+    auto stale_time = source_time - chrono::hours(1);
+    filesystem::last_write_time(cache_path, stale_time);
+    filesystem::last_write_time(source_path, source_time + chrono::hours(1));
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 999");
+    EXPECT_GT(filesystem::last_write_time(cache_path), stale_time);
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 999");
+
+    // A truncated cache is ignored and replaced
+    auto cache_size = filesystem::file_size(cache_path);
+    filesystem::resize_file(cache_path, cache_size / 2);
+    Table table(source_path, false, true);
+    ASSERT_TRUE(table.IsValid());
+    EXPECT_EQ(table.NumRows(), 3);
+    EXPECT_EQ(table.View().Values<int16_t>(table["e_RVel"]), std::vector<int16_t>({5, 6, 3}));
+    EXPECT_EQ(filesystem::file_size(cache_path), cache_size);
+
+    // A corrupt row count that would overflow the sizes computed from it is rejected. The count follows the magic, the
+    // version and the source path, size and modification time
+    {
+        fstream file(cache_path, ios::in | ios::out | ios::binary);
+        file.seekp(8 + sizeof(uint32_t) + sizeof(uint64_t) + filesystem::canonical(source_path).string().size() + 2 * sizeof(uint64_t));
+        uint64_t num_rows = uint64_t(1) << 61;
+        file.write(reinterpret_cast<const char*>(&num_rows), sizeof(num_rows));
+    }
+    Table corrupt_table(source_path, false, true);
+    ASSERT_TRUE(corrupt_table.IsValid());
+    EXPECT_EQ(corrupt_table.NumRows(), 3);
+    EXPECT_EQ(first_name(corrupt_table), "N 999");
+
+    filesystem::remove(cache_path);
+    filesystem::remove(source_path);
+}
+
+TEST(ParsedTable, SharedTableCache) {
+    TableCache cache;
+    auto first = cache.Get(test_path("ivoa_example.fits"));
+    ASSERT_TRUE(first);
+    EXPECT_TRUE(first->IsValid());
+    EXPECT_EQ(cache.Get(test_path("ivoa_example.fits")), first);
+    EXPECT_EQ(cache.NumTables(), 1);
+    EXPECT_GT(cache.MemoryUsage(), 0);
+    EXPECT_FALSE(cache.Get(test_path("invalid.fits")));
+    EXPECT_EQ(cache.NumTables(), 1);
+
+    // Concurrent requests share a single load
+    cache.Clear();
+    auto request = [&]() {
+        return cache.Get(test_path("ivoa_example.fits"));
+    };
+    auto async_first = async(launch::async, request);
+    auto async_second = async(launch::async, request);
+    first = async_first.get();
+    EXPECT_EQ(async_second.get(), first);
+    EXPECT_EQ(cache.NumTables(), 1);
+
+    // Tables that are still in use are not evicted
+    cache.SetMemoryBudget(0);
+    EXPECT_EQ(cache.NumTables(), 1);
+    EXPECT_EQ(cache.Get(test_path("ivoa_example.fits")), first);
+    first.reset();
+    cache.SetMemoryBudget(0);
+    EXPECT_EQ(cache.NumTables(), 0);
+    EXPECT_EQ(cache.MemoryUsage(), 0);
+}
+
+TEST(ParsedTable, OutOfCoreStorage) {
+    Table table(test_path("ivoa_example.fits"));
+    Table scratch_table(test_path("ivoa_example.fits"), false, false, filesystem::temp_directory_path().string());
+    ASSERT_TRUE(scratch_table.IsValid());
+    EXPECT_EQ(scratch_table.NumRows(), table.NumRows());
+    EXPECT_EQ(scratch_table.NumColumns(), table.NumColumns());
+
+    auto view = table.View();
+    auto scratch_view = scratch_table.View();
+    EXPECT_EQ(scratch_view.Values<string>(scratch_table["Name"]), view.Values<string>(table["Name"]));
+    EXPECT_EQ(scratch_view.ValuesAs<double>(scratch_table["RVel"]), view.ValuesAs<double>(table["RVel"]));
+    EXPECT_TRUE(scratch_view.NumericFilter(scratch_table["RVel"], GREATER, 0));
+    EXPECT_EQ(scratch_view.NumRows(), 1);
+
+    // Entries of a column with storage are mapped from the scratch file
+    auto storage = ColumnStorage::FromScratchDirectory(filesystem::temp_directory_path().string());
+    ASSERT_TRUE(storage);
+    DataColumn<double> column("scratch");
+    column.SetStorage(storage);
+    column.Resize(100000);
+    EXPECT_GE(storage->AllocatedSize(), 100000 * sizeof(double));
+    std::iota(column.entries.begin(), column.entries.end(), 0.0);
+    column.ComputeBlockStatistics();
+    IndexList indices;
+    column.FilterIndices(indices, false, RANGE_INCLUSIVE, 10, 19);
+    EXPECT_EQ(indices.size(), 10);
+    column.Resize(0);
+    column.entries.shrink_to_fit();
+    EXPECT_EQ(storage->AllocatedSize(), 0);
+}
+
+TEST(ParsedTable, ChunkedRead) {
+    // Tables read in chunks of a few rows, or of a single row per thread, match the rows written to the file
+    int64_t num_rows = 10000;
+    std::vector<string> names(num_rows);
+    std::vector<int64_t> indices(num_rows);
+    std::vector<double> values(num_rows);
+    std::vector<char*> name_pointers;
+    for (int64_t i = 0; i < num_rows; i++) {
+        names[i] = fmt::format("row {}", i);
+        indices[i] = i * 1000003;
+        values[i] = i * 0.25 - 7;
+    }
+    for (auto& name: names) {
+        name_pointers.push_back(name.data());
+    }
+    auto path = (filesystem::temp_directory_path() / "chunked_read.fits").string();
+    {
+        char* column_names[] = {(char*) "Name", (char*) "Index", (char*) "Value"};
+        char* column_formats[] = {(char*) "12A", (char*) "1K", (char*) "1D"};
+        fitsfile* file_ptr;
+        int status = 0;
+        fits_create_file(&file_ptr, ("!" + path).c_str(), &status);
+        fits_create_tbl(file_ptr, BINARY_TBL, num_rows, 3, column_names, column_formats, nullptr, "chunks", &status);
+        fits_write_col(file_ptr, TSTRING, 1, 1, 1, num_rows, name_pointers.data(), &status);
+        fits_write_col(file_ptr, TLONGLONG, 2, 1, 1, num_rows, indices.data(), &status);
+        fits_write_col(file_ptr, TDOUBLE, 3, 1, 1, num_rows, values.data(), &status);
+        fits_close_file(file_ptr, &status);
+        ASSERT_EQ(status, 0);
+    }
+
+    // Rows are 28 bytes wide
+    for (size_t read_chunk_size: {size_t(1), size_t(28 * 7), size_t(28 * 1000), size_t(FITS_READ_CHUNK_SIZE)}) {
+        for (auto scratch_directory: {string(), filesystem::temp_directory_path().string()}) {
+            Table table(path, false, false, scratch_directory, read_chunk_size);
+            ASSERT_TRUE(table.IsValid());
+            ASSERT_EQ(table.NumRows(), num_rows);
+            auto view = table.View();
+            EXPECT_EQ(view.Values<string>(table["Name"]), names);
+            EXPECT_EQ(view.Values<int64_t>(table["Index"]), indices);
+            EXPECT_EQ(view.Values<double>(table["Value"]), values);
+            // Block statistics are computed after the last chunk is read
+            EXPECT_TRUE(view.NumericFilter(table["Index"], GREATER_OR_EQUAL, indices[num_rows - 5]));
+            EXPECT_EQ(view.NumRows(), 5);
+        }
+    }
+    filesystem::remove(path);
+}
+
 TEST(Filtering, FailOnWrongFilterType) {
     Table table(test_path("ivoa_example.fits"));
     EXPECT_FALSE(table.View().StringFilter(table["dummy"], "N 224"));
@@ -167,6 +386,8 @@ TEST(Filtering, FailFilterExtractMistypedValues) {
     EXPECT_TRUE(double_vals.empty());
     auto string_vals = view.Values<string>(table["RA"]);
     EXPECT_TRUE(string_vals.empty());
+    auto bool_vals = view.Values<bool>(table["RA"]);
+    EXPECT_TRUE(bool_vals.empty());
 
     view.StringFilter(table["Name"], "N 6744");
     auto float_vals = view.Values<float>(table["Name"]);
@@ -188,6 +409,97 @@ TEST(Filtering, FilterExtractValues) {
     EXPECT_FLOAT_EQ(float_vals[0], 287.43f);
 }
 
+TEST(Filtering, FilterExtractValuesWithoutCopying) {
+    Table table(test_path("ivoa_example.fits"));
+
+    // Full views give direct access to a column's entries
+    auto view = table.View();
+    auto span = view.ValuesSpan<float>(table["RA"], 1);
+    ASSERT_EQ(span.size(), 2);
+    EXPECT_FLOAT_EQ(span[0], 287.43f);
+    EXPECT_FLOAT_EQ(span[1], 23.48f);
+    EXPECT_TRUE(view.ValuesSpan<double>(table["RA"]).empty());
+
+    float buffer[3] = {0, 0, 0};
+    EXPECT_EQ(view.FillValues(table["RA"], buffer, 2, 10), 1);
+    EXPECT_FLOAT_EQ(buffer[0], 23.48f);
+
+    // Subsets are gathered into the buffer
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"]);
+    EXPECT_TRUE(view.ValuesSpan<float>(table["RA"]).empty());
+    EXPECT_EQ(view.FillValues(table["RA"], buffer), 2);
+    EXPECT_FLOAT_EQ(buffer[0], 23.48f);
+    EXPECT_FLOAT_EQ(buffer[1], 287.43f);
+    std::string names[1];
+    EXPECT_EQ(view.FillValues(table["Name"], names, 1), 1);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(view.FillValues(table["Name"], buffer), 0);
+}
+
+TEST(Filtering, FilterExtractConvertedValues) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_EQ(view.ValuesAs<double>(table["RVel"]), std::vector<double>({-297, 839, -182}));
+    EXPECT_TRUE(view.ValuesAs<double>(table["Name"]).empty());
+    EXPECT_TRUE(view.ValuesAs<double>(nullptr).empty());
+
+    // Floating-point entries are rounded towards zero and saturate when converted to integers
+    auto int8_vals = view.ValuesAs<int8_t>(table["RA"]);
+    EXPECT_EQ(int8_vals, std::vector<int8_t>({10, 127, 23}));
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"], false);
+    auto float_vals = view.ValuesAs<float>(table["e_RVel"], 1);
+    EXPECT_EQ(float_vals, std::vector<float>({3}));
+    double buffer[2];
+    EXPECT_EQ(view.FillValuesAs(table["RA"], buffer), 2);
+    EXPECT_NEAR(buffer[0], 287.43, 1e-4);
+    EXPECT_NEAR(buffer[1], 23.48, 1e-4);
+}
+
+TEST(Filtering, FilterExtractBatch) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    RowBatch batch;
+    EXPECT_FALSE(view.FillBatch({table["RA"], nullptr}, 0, 3, batch));
+
+    // Row-major batches hold complete rows, with strings padded to the longest string
+    std::vector<const Column*> columns = {table["RA"], table["RVel"], table["Name"]};
+    EXPECT_TRUE(view.FillBatch(columns, 1, 10, batch));
+    EXPECT_EQ(batch.start, 1);
+    EXPECT_EQ(batch.num_rows, 2);
+    EXPECT_EQ(batch.entry_sizes, std::vector<size_t>({4, 4, 6}));
+    EXPECT_EQ(batch.column_offsets, std::vector<size_t>({0, 4, 8}));
+    ASSERT_EQ(batch.data.size(), 28);
+    float ra;
+    int32_t rvel;
+    memcpy(&ra, batch.data.data() + batch.row_size, sizeof(float));
+    memcpy(&rvel, batch.data.data() + batch.row_size + 4, sizeof(int32_t));
+    EXPECT_FLOAT_EQ(ra, 23.48f);
+    EXPECT_EQ(rvel, -182);
+    EXPECT_EQ(std::string((char*) batch.data.data() + batch.row_size + 8, 6), std::string("N 598\0", 6));
+
+    // Column-major batches hold complete columns
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"], false);
+    EXPECT_TRUE(view.FillBatch(columns, 0, 2, batch, COLUMN_MAJOR));
+    EXPECT_EQ(batch.column_offsets, std::vector<size_t>({0, 8, 16}));
+    memcpy(&rvel, batch.data.data() + 8 + 4, sizeof(int32_t));
+    EXPECT_EQ(rvel, -182);
+
+    // Prefetched batches are used only if the rows of the view are unchanged
+    EXPECT_TRUE(view.PrefetchBatch(columns, 0, 1));
+    EXPECT_TRUE(view.FillBatch(columns, 0, 1, batch));
+    EXPECT_EQ(std::string((char*) batch.data.data() + 8, 6), "N 6744");
+    EXPECT_TRUE(view.PrefetchBatch(columns, 0, 1));
+    view.SortByColumn(table["RA"], true);
+    EXPECT_TRUE(view.FillBatch(columns, 0, 1, batch));
+    EXPECT_EQ(std::string((char*) batch.data.data() + 8, 5), "N 598");
+}
+
 TEST(Filtering, NumericFilterEqual) {
     Table table(test_path("ivoa_example.fits"));
     auto view = table.View();
@@ -244,6 +556,366 @@ TEST(Filtering, NumericFilterRange) {
     EXPECT_EQ(view.NumRows(), 0);
 }
 
+TEST(Filtering, BlockStatistics) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto& stats = DataColumn<float>::TryCast(table["RA"])->block_statistics;
+    EXPECT_EQ(stats.size(), 1);
+    EXPECT_FLOAT_EQ(stats[0].min, 10.68f);
+    EXPECT_FLOAT_EQ(stats[0].max, 287.43f);
+    EXPECT_EQ(stats[0].nan_count, 0);
+    EXPECT_TRUE(DataColumn<string>::TryCast(table["Name"])->block_statistics.empty());
+}
+
+TEST(Filtering, CombineViews) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto first_view = table.View();
+    first_view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    auto second_view = table.View();
+    second_view.NumericFilter(table["e_RVel"], LESSER_OR_EQUAL, 5);
+
+    auto union_view = first_view;
+    EXPECT_TRUE(union_view.Combine(second_view, UNION));
+    EXPECT_EQ(union_view.NumRows(), 3);
+
+    auto intersection_view = first_view;
+    EXPECT_TRUE(intersection_view.Combine(second_view, INTERSECTION));
+    auto vals = intersection_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+
+    auto symmetric_difference_view = first_view;
+    EXPECT_TRUE(symmetric_difference_view.Combine(second_view, SYMMETRIC_DIFFERENCE));
+    vals = symmetric_difference_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 10.68f);
+    EXPECT_FLOAT_EQ(vals[1], 287.43f);
+
+    auto difference_view = first_view;
+    EXPECT_TRUE(difference_view.Combine(second_view, DIFFERENCE));
+    vals = difference_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+}
+
+TEST(Filtering, CombineUnorderedViews) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto sorted_view = table.View();
+    sorted_view.SortByColumn(table["RA"], false);
+    auto second_view = table.View();
+    second_view.NumericFilter(table["e_RVel"], LESSER_OR_EQUAL, 5);
+
+    // Intersection retains the order of the sorted view
+    EXPECT_TRUE(sorted_view.Combine(second_view, INTERSECTION));
+    auto vals = sorted_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+    EXPECT_FLOAT_EQ(vals[1], 10.68f);
+
+    EXPECT_TRUE(sorted_view.Invert());
+    vals = sorted_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+}
+
+TEST(Filtering, SkyRegionFilters) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.ConeFilter(table["RA"], table["Name"], 10, 40, 1));
+    EXPECT_FALSE(view.ConeFilter(table["RA"], table["Dec"], 10, 40, -1));
+    EXPECT_FALSE(view.SkyPolygonFilter(table["RA"], table["Dec"], {0, 10}, {0, 10}));
+
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 10.68, 41.27, 1));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 10.68, 41.27, 15));
+    EXPECT_EQ(view.NumRows(), 2);
+
+    // Cones and boxes may cross RA = 0, and cones may contain a pole
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 359, 41.27, 12));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 0, 90, 50));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.SkyBoxFilter(table["RA"], table["Dec"], 280, 20, -90, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 6744"}));
+
+    // Filters compose with the existing rows of the view
+    EXPECT_TRUE(view.SkyBoxFilter(table["RA"], table["Dec"], 0, 360, -70, 35));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 6744"}));
+
+    view.Reset();
+    view.SortByColumn(table["RA"], false);
+    EXPECT_TRUE(view.SkyPolygonFilter(table["RA"], table["Dec"], {355, 30, 30, 355}, {25, 25, 45, 45}));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 598", "N 224"}));
+}
+
+TEST(Filtering, PlanarRegionFilters) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.PolygonFilter(table["RA"], table["Name"], {0, 30, 30}, {25, 25, 45}));
+    EXPECT_FALSE(view.PolygonFilter(table["RA"], table["Dec"], {0, 30}, {25, 25}));
+    EXPECT_FALSE(view.EllipseFilter(table["R"], table["RVel"], 0, 0, 1, 0));
+    EXPECT_EQ(view.NumRows(), 3);
+
+    EXPECT_TRUE(view.PolygonFilter(table["RA"], table["Dec"], {0, 30, 30, 15, 0}, {25, 25, 45, 42, 45}));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 598"}));
+
+    // Filters compose with the existing rows of the view, and can mix column types
+    EXPECT_TRUE(view.EllipseFilter(table["R"], table["RVel"], 0.7, -297, 10, 1, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+
+    view.Reset();
+    view.SortByColumn(table["RVel"], false);
+    EXPECT_TRUE(view.EllipseFilter(table["R"], table["RVel"], 0.7, -240, 60, 1, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 598", "N 224"}));
+}
+
+TEST(Filtering, CrossMatchTables) {
+    Table table(test_path("ivoa_example.fits"));
+    Table other(test_path("ivoa_example.fits"));
+
+    std::vector<MatchedRows> matches;
+    EXPECT_FALSE(table.CrossMatch(table["RA"], table["Name"], other, other["RA"], other["Dec"], 1, matches));
+    EXPECT_FALSE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], -1, matches));
+
+    // Each row matches itself, and rows 0 and 2 are about 14.8 degrees apart
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 20, matches));
+    ASSERT_EQ(matches.size(), 3);
+    for (int64_t i = 0; i < 3; i++) {
+        EXPECT_EQ(matches[i].row, i);
+        EXPECT_EQ(matches[i].other_row, i);
+        EXPECT_NEAR(matches[i].separation, 0, 1e-6);
+    }
+
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 20, matches, ALL_MATCHES));
+    ASSERT_EQ(matches.size(), 5);
+    std::vector<int64_t> rows, other_rows;
+    for (auto& match: matches) {
+        rows.push_back(match.row);
+        other_rows.push_back(match.other_row);
+    }
+    EXPECT_EQ(rows, std::vector<int64_t>({0, 0, 1, 2, 2}));
+    EXPECT_EQ(other_rows, std::vector<int64_t>({0, 2, 1, 2, 0}));
+    EXPECT_NEAR(matches[1].separation, 14.797, 1e-3);
+
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 10, matches, ALL_MATCHES));
+    EXPECT_EQ(matches.size(), 3);
+}
+
+TEST(Filtering, JoinTables) {
+    Table table(test_path("ivoa_example.fits"));
+    Table other(test_path("ivoa_example.fits"));
+
+    EXPECT_FALSE(table.View().Join(table["R"], other.View(), other["R"]).IsValid());
+    EXPECT_FALSE(table.View().Join(table["Name"], other.View(), other["RVel"]).IsValid());
+    auto mixed_widths = table.View().Join(table["e_RVel"], other.View(), other["RVel"]);
+    EXPECT_TRUE(mixed_widths.IsValid());
+    EXPECT_EQ(mixed_widths.NumRows(), 0);
+
+    // Joined rows follow the order of the left view
+    auto left_view = table.View();
+    left_view.NumericFilter(table["RVel"], LESSER, 0);
+    auto right_view = other.View();
+    right_view.SortByColumn(other["RA"], false);
+    auto joined = left_view.Join(table["Name"], right_view, other["Name"]);
+    EXPECT_TRUE(joined.IsValid());
+    EXPECT_EQ(joined.LeftRows(), IndexList({0, 2}));
+    EXPECT_EQ(joined.RightRows(), IndexList({0, 2}));
+    EXPECT_EQ(joined.Values<int32_t>(other["RVel"]), std::vector<int32_t>({-297, -182}));
+
+    // Unmatched rows of a left join use missing entries from the right table
+    right_view.Reset();
+    right_view.NumericFilter(other["RVel"], GREATER, 0);
+    auto left_joined = table.View().Join(table["Name"], right_view, other["Name"], LEFT_JOIN);
+    EXPECT_EQ(left_joined.NumRows(), 3);
+    EXPECT_EQ(left_joined.RightRows(), IndexList({-1, 1, -1}));
+    EXPECT_EQ(left_joined.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 6744", "N 598"}));
+    EXPECT_EQ(left_joined.Values<string>(other["Name"]), std::vector<string>({"", "N 6744", ""}));
+    std::vector<double> velocities(3);
+    EXPECT_EQ(left_joined.FillValuesAs(other["RVel"], velocities.data()), 3);
+    EXPECT_TRUE(std::isnan(velocities[0]) && std::isnan(velocities[2]));
+    EXPECT_EQ(velocities[1], 839);
+    EXPECT_EQ(left_joined.FillValuesAs(other["RVel"], velocities.data(), 0, -1, -1.0), 3);
+    EXPECT_EQ(velocities, std::vector<double>({-1, 839, -1}));
+}
+
+TEST(Aggregation, ColumnStatistics) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    ColumnStatistics stats;
+    EXPECT_FALSE(view.Aggregate(nullptr, stats));
+    EXPECT_FALSE(view.Aggregate(table["Name"], stats));
+
+    EXPECT_TRUE(view.Aggregate(table["e_RVel"], stats));
+    EXPECT_EQ(stats.count, 3);
+    EXPECT_EQ(stats.nan_count, 0);
+    EXPECT_DOUBLE_EQ(stats.sum, 14);
+    EXPECT_DOUBLE_EQ(stats.mean, 14.0 / 3.0);
+    EXPECT_DOUBLE_EQ(stats.min, 3);
+    EXPECT_DOUBLE_EQ(stats.max, 6);
+    EXPECT_DOUBLE_EQ(stats.variance, 14.0 / 9.0);
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Aggregate(table["RA"], stats));
+    EXPECT_EQ(stats.count, 2);
+    EXPECT_NEAR(stats.mean, (287.43 + 23.48) / 2, 1e-4);
+    EXPECT_FLOAT_EQ(stats.min, 23.48f);
+    EXPECT_FLOAT_EQ(stats.max, 287.43f);
+}
+
+TEST(Aggregation, Histogram) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    ColumnHistogram histogram;
+    EXPECT_FALSE(view.Histogram(nullptr, 3, histogram));
+    EXPECT_FALSE(view.Histogram(table["Name"], 3, histogram));
+    EXPECT_FALSE(view.Histogram(table["e_RVel"], 0, histogram));
+
+    // Automatic range, with the maximum included in the last bin
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_DOUBLE_EQ(histogram.min, 3);
+    EXPECT_DOUBLE_EQ(histogram.max, 6);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 2}));
+
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 2, histogram, false, 0, 10));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 2}));
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 2, histogram, false, 4, NAN));
+    EXPECT_DOUBLE_EQ(histogram.min, 4);
+    EXPECT_DOUBLE_EQ(histogram.max, 6);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({0, 2}));
+
+    // Log-scale ranges exclude non-positive entries
+    EXPECT_TRUE(view.Histogram(table["R"], 2, histogram, true));
+    EXPECT_TRUE(histogram.log_scale);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({2, 1}));
+    EXPECT_TRUE(view.Histogram(table["RVel"], 2, histogram, true));
+    EXPECT_DOUBLE_EQ(histogram.min, 839);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0}));
+    EXPECT_FALSE(view.Histogram(table["RVel"], 2, histogram, true, 0, 1000));
+
+    // Cached histograms are discarded when the view changes
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 1}));
+    view.Reset();
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 2}));
+}
+
+TEST(Aggregation, GroupBy) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.GroupBy(nullptr).IsValid());
+
+    // Floating-point keys are hashed
+    auto groups = view.GroupBy(table["R"]);
+    EXPECT_TRUE(groups.IsValid());
+    EXPECT_EQ(groups.NumGroups(), 2);
+    auto float_keys = groups.Keys<float>();
+    ASSERT_EQ(float_keys.size(), 2);
+    EXPECT_FLOAT_EQ(float_keys[0], 0.7f);
+    EXPECT_FLOAT_EQ(float_keys[1], 10.4f);
+    EXPECT_EQ(groups.GroupSizes(), IndexList({2, 1}));
+    EXPECT_TRUE(groups.Keys<double>().empty());
+
+    std::vector<ColumnStatistics> stats;
+    EXPECT_FALSE(groups.Aggregate(table["Name"], stats));
+    EXPECT_TRUE(groups.Aggregate(table["e_RVel"], stats));
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_EQ(stats[0].count, 2);
+    EXPECT_DOUBLE_EQ(stats[0].mean, 4);
+    EXPECT_DOUBLE_EQ(stats[0].variance, 1);
+    EXPECT_EQ(stats[1].count, 1);
+    EXPECT_DOUBLE_EQ(stats[1].mean, 6);
+
+    // Small-range integer keys are indexed directly
+    auto int_groups = view.GroupBy(table["e_RVel"]);
+    EXPECT_EQ(int_groups.Keys<int16_t>(), std::vector<int16_t>({3, 5, 6}));
+    EXPECT_EQ(int_groups.GroupSizes(), IndexList({1, 1, 1}));
+
+    auto string_groups = view.GroupBy(table["Name"]);
+    EXPECT_EQ(string_groups.Keys<std::string>(), std::vector<std::string>({"N 224", "N 598", "N 6744"}));
+
+    // Only the rows of a filtered view are grouped
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    auto filtered_groups = view.GroupBy(table["R"]);
+    EXPECT_EQ(filtered_groups.GroupSizes(), IndexList({1, 1}));
+    EXPECT_TRUE(filtered_groups.Aggregate(table["RVel"], stats));
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_DOUBLE_EQ(stats[0].sum, -182);
+    EXPECT_DOUBLE_EQ(stats[1].sum, 839);
+}
+
+TEST(Aggregation, Quantiles) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    std::vector<double> quantiles;
+    EXPECT_FALSE(view.Quantiles(nullptr, {0.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["Name"], {0.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["RA"], {1.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["RA"], {-0.1}, quantiles, true));
+
+    EXPECT_TRUE(view.Quantiles(table["e_RVel"], {0.75, 0.5}, quantiles, true));
+    EXPECT_EQ(quantiles, std::vector<double>({5.5, 5}));
+    // Exact quantiles of the full table use the sorted index if it has been cached
+    ASSERT_TRUE(table.SortedIndices(table["e_RVel"]));
+    EXPECT_TRUE(view.Quantiles(table["e_RVel"], {0.75, 0.5}, quantiles, true));
+    EXPECT_EQ(quantiles, std::vector<double>({5.5, 5}));
+
+    // The sketch keeps small columns exactly
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0, 0.5, 1}, quantiles));
+    ASSERT_EQ(quantiles.size(), 3);
+    EXPECT_FLOAT_EQ(quantiles[0], 10.68f);
+    EXPECT_FLOAT_EQ(quantiles[1], 23.48f);
+    EXPECT_FLOAT_EQ(quantiles[2], 287.43f);
+
+    EXPECT_TRUE(view.ClipByQuantiles(table["RA"], 0, 0.5, true));
+    EXPECT_EQ(view.NumRows(), 2);
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0.5}, quantiles));
+    EXPECT_NEAR(quantiles[0], (10.68 + 23.48) / 2, 1e-4);
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0.5}, quantiles, true));
+    EXPECT_NEAR(quantiles[0], (10.68 + 23.48) / 2, 1e-4);
+}
+
+TEST(Aggregation, Density) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    DensityGrid grid;
+    EXPECT_FALSE(view.Density(table["RA"], table["Name"], 2, 2, grid));
+    EXPECT_FALSE(view.Density(table["RA"], table["Dec"], 0, 2, grid));
+
+    // Coarse grids over the full range are re-binned from the pyramid
+    EXPECT_TRUE(view.Density(table["RA"], table["Dec"], 2, 2, grid));
+    EXPECT_FLOAT_EQ(grid.x_min, 10.68f);
+    EXPECT_FLOAT_EQ(grid.y_max, 41.27f);
+    EXPECT_EQ(grid.counts, std::vector<int64_t>({0, 1, 2, 0}));
+    EXPECT_EQ(grid.rows, IndexList({-1, 1, 0, -1}));
+
+    // Fine grids are binned directly
+    EXPECT_TRUE(view.Density(table["RA"], table["RVel"], 400, 1, grid, 0, 40));
+    EXPECT_EQ(std::accumulate(grid.counts.begin(), grid.counts.end(), int64_t(0)), 2);
+    EXPECT_EQ(grid.counts[106], 1);
+    EXPECT_EQ(grid.rows[234], 2);
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Density(table["RA"], table["Dec"], 1, 2, grid));
+    EXPECT_FLOAT_EQ(grid.x_min, 23.48f);
+    EXPECT_EQ(grid.counts, std::vector<int64_t>({1, 1}));
+    EXPECT_EQ(grid.rows, IndexList({1, 2}));
+}
+
 TEST(Sorting, FailSortMissingColummn) {
     Table table(test_path("ivoa_example.fits"));
 
@@ -319,6 +991,152 @@ TEST(Sorting, SortStringSubset) {
     EXPECT_EQ(vals[1], "N 6744");
 }
 
+TEST(Sorting, TopRows) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.TopByColumn(nullptr, 2));
+    EXPECT_TRUE(view.TopByColumn(table["RA"], 2, false));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+}
+
+TEST(Sorting, TopRowsTies) {
+    Table table(test_path("ivoa_example.fits"));
+
+    // Tied rows keep their table order whether or not the column has a cached sorted index
+    for (auto cached: {false, true}) {
+        if (cached) {
+            ASSERT_NE(table.SortedIndices(table["R"]), nullptr);
+        }
+        auto view = table.View();
+        EXPECT_TRUE(view.TopByColumn(table["R"], 3, false));
+        auto names = view.Values<string>(table["Name"]);
+        ASSERT_EQ(names.size(), 3);
+        EXPECT_EQ(names[0], "N 6744");
+        EXPECT_EQ(names[1], "N 224");
+        EXPECT_EQ(names[2], "N 598");
+    }
+}
+
+TEST(Sorting, PartialSort) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_TRUE(view.PartialSortByColumn(table["RA"], 1, 2));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 3);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+
+    // A negative end sorts to the last row
+    view.Reset();
+    EXPECT_TRUE(view.PartialSortByColumn(table["RA"], 1, -1, false));
+    vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+    EXPECT_FLOAT_EQ(vals[2], 10.68f);
+}
+
+TEST(Sorting, SortMultipleColumns) {
+    Table table(test_path("ivoa_example.fits"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.SortByColumns({}));
+    EXPECT_FALSE(view.SortByColumns({{table["R"], true}, {nullptr, true}}));
+    EXPECT_TRUE(view.SortByColumns({{table["R"], true}, {table["RA"], false}}));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+    EXPECT_FLOAT_EQ(vals[1], 10.68f);
+    EXPECT_FLOAT_EQ(vals[2], 287.43f);
+
+    EXPECT_TRUE(view.SortByColumns({{table["R"], false}, {table["Name"], true}}));
+    auto names = view.Values<string>(table["Name"]);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(names[1], "N 224");
+    EXPECT_EQ(names[2], "N 598");
+
+    // A single descending column keeps rows with equal values in their existing order
+    view.Reset();
+    EXPECT_TRUE(view.SortByColumns({{table["R"], false}}));
+    names = view.Values<string>(table["Name"]);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(names[1], "N 224");
+    EXPECT_EQ(names[2], "N 598");
+}
+
+TEST(Sorting, CachedSortedIndex) {
+    Table table(test_path("ivoa_example.fits"));
+
+    EXPECT_EQ(table.SortedIndices(nullptr), nullptr);
+    EXPECT_EQ(table.SortedIndices(table["RA"], false), nullptr);
+    auto sorted_indices = table.SortedIndices(table["RA"]);
+    ASSERT_NE(sorted_indices, nullptr);
+    EXPECT_EQ(*sorted_indices, IndexList({0, 2, 1}));
+    EXPECT_EQ(table.SortedIndices(table["RA"], false), sorted_indices);
+
+    // Filters on a column with a cached index must give the same results as a scan
+    auto view = table.View();
+    view.NumericFilter(table["RA"], RANGE_INCLUSIVE, 11, 300);
+    EXPECT_EQ(view.NumRows(), 2);
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+}
+
+TEST(Sorting, SortLongStringPrefixes) {
+    // Names share prefixes longer than their normalized keys, or differ only in length. Equal names are ordered by group
+    std::vector<string> names = {"NAME COSMOS J100012+020304", "NAME COSMOS J100012+020303", "NAME COSMOS J1000", "NAME COSMOS J100012",
+        "NAME COSMOS J100", "NAME COSMOS J100012+020304", "NAME COS", "NAME COSMOS J100012+0203"};
+    std::vector<int32_t> groups = {1, 0, 0, 1, 0, 0, 1, 1};
+    auto path = (filesystem::temp_directory_path() / "long_prefixes.fits").string();
+    {
+        // Strings are padded with spaces to the column width, which are trimmed when the table is read
+        std::vector<string> padded_names;
+        std::vector<char*> name_pointers;
+        for (auto& name: names) {
+            padded_names.push_back(fmt::format("{:<32}", name));
+        }
+        for (auto& name: padded_names) {
+            name_pointers.push_back(name.data());
+        }
+        char* column_names[] = {(char*) "Name", (char*) "Group"};
+        char* column_formats[] = {(char*) "32A", (char*) "1J"};
+        fitsfile* file_ptr;
+        int status = 0;
+        fits_create_file(&file_ptr, ("!" + path).c_str(), &status);
+        fits_create_tbl(file_ptr, BINARY_TBL, names.size(), 2, column_names, column_formats, nullptr, "prefixes", &status);
+        fits_write_col(file_ptr, TSTRING, 1, 1, 1, names.size(), name_pointers.data(), &status);
+        fits_write_col(file_ptr, TINT, 2, 1, 1, groups.size(), groups.data(), &status);
+        fits_close_file(file_ptr, &status);
+        ASSERT_EQ(status, 0);
+    }
+
+    Table table(path);
+    ASSERT_TRUE(table.IsValid());
+    for (auto ascending: {true, false}) {
+        IndexList expected(names.size());
+        iota(expected.begin(), expected.end(), 0);
+        std::stable_sort(expected.begin(), expected.end(), [&](int64_t a, int64_t b) {
+            if (names[a] != names[b]) {
+                return ascending ? names[a] < names[b] : names[a] > names[b];
+            }
+            return groups[a] < groups[b];
+        });
+
+        auto view = table.View();
+        EXPECT_TRUE(view.SortByColumns({{table["Name"], ascending}, {table["Group"], true}}));
+        auto sorted_names = view.Values<string>(table["Name"]);
+        auto sorted_groups = view.Values<int32_t>(table["Group"]);
+        ASSERT_EQ(sorted_names.size(), names.size());
+        for (auto i = 0; i < names.size(); i++) {
+            EXPECT_EQ(sorted_names[i], names[expected[i]]);
+            EXPECT_EQ(sorted_groups[i], groups[expected[i]]);
+        }
+    }
+    filesystem::remove(path);
+}
+
 TEST(Arrays, ParseArrayFile) {
     Table table(test_path("array_types.fits"));
     EXPECT_TRUE(table.IsValid());
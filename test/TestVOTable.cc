@@ -1,7 +1,14 @@
 #include <gtest/gtest.h>
 #include <fmt/format.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <random>
 
 #include "Table.h"
+#include "TableCache.h"
+#include "DataColumn.tcc"
 
 using namespace std;
 using namespace carta;
@@ -12,6 +19,27 @@ string test_path(const string& filename) {
     return fmt::format("{}/{}", test_base, filename);
 }
 
+// Writes a table of double columns to a temporary file, returning its path
+string write_synthetic_table(const string& filename, const vector<pair<string, vector<double>>>& columns) {
+    auto path = (filesystem::temp_directory_path() / filename).string();
+    ofstream file(path);
+    file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<VOTABLE version=\"1.4\">\n<RESOURCE>\n<TABLE>\n";
+    for (auto& [name, entries]: columns) {
+        file << fmt::format("<FIELD name=\"{}\" datatype=\"double\"/>\n", name);
+    }
+    file << "<DATA>\n<TABLEDATA>\n";
+    size_t num_rows = columns.empty() ? 0 : columns[0].second.size();
+    for (size_t i = 0; i < num_rows; i++) {
+        file << "<TR>";
+        for (auto& [name, entries]: columns) {
+            file << fmt::format("<TD>{}</TD>", entries[i]);
+        }
+        file << "</TR>\n";
+    }
+    file << "</TABLEDATA>\n</DATA>\n</TABLE>\n</RESOURCE>\n</VOTABLE>\n";
+    return path;
+}
+
 TEST(BasicParsing, FailOnEmptyFilename) {
     Table table("");
     EXPECT_FALSE(table.IsValid());
@@ -168,6 +196,238 @@ TEST(ParsedTable, CorrectDataValues) {
     EXPECT_EQ(col5_vals[1], 6);
 }
 
+TEST(ParsedTable, LoadFromColumnCache) {
+    // Work on a copy of the file, so that the cache is not written next to the test data
+    auto source_path = (filesystem::temp_directory_path() / "ivoa_example_cache.xml").string();
+    auto cache_path = source_path + TABLE_CACHE_SUFFIX;
+    filesystem::copy_file(test_path("ivoa_example.xml"), source_path, filesystem::copy_options::overwrite_existing);
+    filesystem::remove(cache_path);
+
+    Table parsed_table(source_path, false, true);
+    ASSERT_TRUE(parsed_table.IsValid());
+    EXPECT_TRUE(filesystem::exists(cache_path));
+
+    Table cached_table(source_path, false, true);
+    ASSERT_TRUE(cached_table.IsValid());
+    EXPECT_EQ(cached_table.NumRows(), 3);
+    EXPECT_EQ(cached_table.NumColumns(), parsed_table.NumColumns());
+    for (size_t i = 0; i < parsed_table.NumColumns(); i++) {
+        EXPECT_EQ(cached_table[i]->name, parsed_table[i]->name);
+        EXPECT_EQ(cached_table[i]->unit, parsed_table[i]->unit);
+        EXPECT_EQ(cached_table[i]->data_type, parsed_table[i]->data_type);
+        EXPECT_EQ(cached_table[i]->data_type_size, parsed_table[i]->data_type_size);
+    }
+    auto view = cached_table.View();
+    EXPECT_EQ(view.Values<string>(cached_table["col3"]), std::vector<string>({"N 224", "N 6744", "N 598"}));
+    EXPECT_EQ(view.Values<int16_t>(cached_table["e_RVel"]), std::vector<int16_t>({5, 6, 3}));
+    EXPECT_TRUE(view.NumericFilter(cached_table["RVel"], GREATER, 0));
+    EXPECT_EQ(view.NumRows(), 1);
+
+    filesystem::remove(cache_path);
+    filesystem::remove(source_path);
+}
+
+TEST(ParsedTable, ValidateColumnCache) {
+    auto source_path = (filesystem::temp_directory_path() / "ivoa_example_validation.xml").string();
+    auto cache_path = source_path + TABLE_CACHE_SUFFIX;
+    filesystem::copy_file(test_path("ivoa_example.xml"), source_path, filesystem::copy_options::overwrite_existing);
+    filesystem::remove(cache_path);
+    auto first_name = [](const Table& table) {
+        auto names = table.View().Values<string>(table["Name"]);
+        return names.empty() ? string() : names.front();
+    };
+    ASSERT_TRUE(Table(source_path, false, true).IsValid());
+    ASSERT_TRUE(filesystem::exists(cache_path));
+
+    // A source edited without changing its size or modification time is still loaded from the cache
+    auto source_time = filesystem::last_write_time(source_path);
+    {
+        fstream file(source_path, ios::in | ios::out | ios::binary);
+        string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        auto position = contents.find("N 224");
+        ASSERT_NE(position, string::npos);
+        file.clear();
+        file.seekp(position);
+        file.write("N 999", 5);
+    }
+    filesystem::last_write_time(source_path, source_time);
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 224");
+    EXPECT_EQ(first_name(Table(source_path)), "N 999");
+
+    // A changed modification time invalidates the cache, which is rewritten after parsing the source
+    auto stale_time = source_time - chrono::hours(1);
+    filesystem::last_write_time(cache_path, stale_time);
+    filesystem::last_write_time(source_path, source_time + chrono::hours(1));
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 999");
+    EXPECT_GT(filesystem::last_write_time(cache_path), stale_time);
+    EXPECT_EQ(first_name(Table(source_path, false, true)), "N 999");
+
+    // A truncated cache is ignored and replaced
+    auto cache_size = filesystem::file_size(cache_path);
+    filesystem::resize_file(cache_path, cache_size / 2);
+    Table table(source_path, false, true);
+    ASSERT_TRUE(table.IsValid());
+    EXPECT_EQ(table.NumRows(), 3);
+    EXPECT_EQ(table.View().Values<int16_t>(table["e_RVel"]), std::vector<int16_t>({5, 6, 3}));
+    EXPECT_EQ(filesystem::file_size(cache_path), cache_size);
+
+    // A corrupt row count that would overflow the sizes computed from it is rejected. The count follows the magic, the
+    // version and the source path, size and modification time
+    {
+        fstream file(cache_path, ios::in | ios::out | ios::binary);
+        file.seekp(8 + sizeof(uint32_t) + sizeof(uint64_t) + filesystem::canonical(source_path).string().size() + 2 * sizeof(uint64_t));
+        uint64_t num_rows = uint64_t(1) << 61;
+        file.write(reinterpret_cast<const char*>(&num_rows), sizeof(num_rows));
+    }
+    Table corrupt_table(source_path, false, true);
+    ASSERT_TRUE(corrupt_table.IsValid());
+    EXPECT_EQ(corrupt_table.NumRows(), 3);
+    EXPECT_EQ(first_name(corrupt_table), "N 999");
+
+    filesystem::remove(cache_path);
+    filesystem::remove(source_path);
+}
+
+TEST(ParsedTable, SharedTableCache) {
+    TableCache cache;
+    auto first = cache.Get(test_path("ivoa_example.xml"));
+    ASSERT_TRUE(first);
+    EXPECT_TRUE(first->IsValid());
+    EXPECT_EQ(cache.Get(test_path("ivoa_example.xml")), first);
+    EXPECT_EQ(cache.NumTables(), 1);
+    EXPECT_GT(cache.MemoryUsage(), 0);
+    EXPECT_FALSE(cache.Get(test_path("invalid.xml")));
+    EXPECT_EQ(cache.NumTables(), 1);
+
+    // Concurrent requests share a single load
+    cache.Clear();
+    auto request = [&]() {
+        return cache.Get(test_path("ivoa_example.xml"));
+    };
+    auto async_first = async(launch::async, request);
+    auto async_second = async(launch::async, request);
+    first = async_first.get();
+    EXPECT_EQ(async_second.get(), first);
+    EXPECT_EQ(cache.NumTables(), 1);
+
+    // Tables that are still in use are not evicted
+    cache.SetMemoryBudget(0);
+    EXPECT_EQ(cache.NumTables(), 1);
+    EXPECT_EQ(cache.Get(test_path("ivoa_example.xml")), first);
+    first.reset();
+    cache.SetMemoryBudget(0);
+    EXPECT_EQ(cache.NumTables(), 0);
+    EXPECT_EQ(cache.MemoryUsage(), 0);
+}
+
+TEST(ParsedTable, OutOfCoreStorage) {
+    Table table(test_path("ivoa_example.xml"));
+    Table scratch_table(test_path("ivoa_example.xml"), false, false, filesystem::temp_directory_path().string());
+    ASSERT_TRUE(scratch_table.IsValid());
+    EXPECT_EQ(scratch_table.NumRows(), table.NumRows());
+    EXPECT_EQ(scratch_table.NumColumns(), table.NumColumns());
+
+    auto view = table.View();
+    auto scratch_view = scratch_table.View();
+    EXPECT_EQ(scratch_view.Values<string>(scratch_table["Name"]), view.Values<string>(table["Name"]));
+    EXPECT_EQ(scratch_view.ValuesAs<double>(scratch_table["RVel"]), view.ValuesAs<double>(table["RVel"]));
+    EXPECT_TRUE(scratch_view.NumericFilter(scratch_table["RVel"], GREATER, 0));
+    EXPECT_EQ(scratch_view.NumRows(), 1);
+
+    // Entries of a column with storage are mapped from the scratch file
+    auto storage = ColumnStorage::FromScratchDirectory(filesystem::temp_directory_path().string());
+    ASSERT_TRUE(storage);
+    DataColumn<double> column("scratch");
+    column.SetStorage(storage);
+    column.Resize(100000);
+    EXPECT_GE(storage->AllocatedSize(), 100000 * sizeof(double));
+    std::iota(column.entries.begin(), column.entries.end(), 0.0);
+    column.ComputeBlockStatistics();
+    IndexList indices;
+    column.FilterIndices(indices, false, RANGE_INCLUSIVE, 10, 19);
+    EXPECT_EQ(indices.size(), 10);
+    column.Resize(0);
+    column.entries.shrink_to_fit();
+    EXPECT_EQ(storage->AllocatedSize(), 0);
+}
+
+TEST(ParsedTable, ArenaStorage) {
+    // Small columns share slabs, while large columns are mapped individually and unmapped when freed
+    auto storage = ColumnStorage::FromArena();
+    DataColumn<int32_t> small_column("small");
+    DataColumn<int32_t> large_column("large");
+    small_column.SetStorage(storage);
+    large_column.SetStorage(storage);
+    small_column.Resize(1000);
+    EXPECT_EQ(storage->AllocatedSize(), ARENA_SLAB_SIZE);
+    large_column.Resize(1000000);
+    EXPECT_GE(storage->AllocatedSize(), ARENA_SLAB_SIZE + 1000000 * sizeof(int32_t));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(large_column.entries.data()) % HUGE_PAGE_SIZE, 0);
+
+    std::iota(small_column.entries.begin(), small_column.entries.end(), 0);
+    std::iota(large_column.entries.begin(), large_column.entries.end(), 0);
+    large_column.ComputeBlockStatistics();
+    IndexList indices;
+    large_column.FilterIndices(indices, false, RANGE_INCLUSIVE, 10, 19);
+    EXPECT_EQ(indices.size(), 10);
+    large_column.Resize(0);
+    large_column.entries.shrink_to_fit();
+    EXPECT_EQ(storage->AllocatedSize(), ARENA_SLAB_SIZE);
+    EXPECT_EQ(small_column.entries[999], 999);
+}
+
+TEST(Filtering, CompressedIntegerColumns) {
+    // Entries with a small range are bit-packed, and runs of equal entries are run-length encoded
+    int64_t num_rows = 100000;
+    DataColumn<int64_t> plain("plain");
+    plain.Resize(num_rows);
+    for (int64_t i = 0; i < num_rows; i++) {
+        plain.entries[i] = i < num_rows / 2 ? i % 7 - 3 : 1000000 + i / 1000;
+    }
+    plain.ComputeBlockStatistics();
+    DataColumn<int64_t> packed("packed");
+    packed.entries = plain.entries;
+    packed.ComputeBlockStatistics();
+    ASSERT_TRUE(packed.Compress());
+    EXPECT_TRUE(packed.entries.empty());
+    EXPECT_EQ(packed.NumEntries(), num_rows);
+    EXPECT_LT(packed.MemorySize(), plain.MemorySize() / 4);
+
+    ColumnEntries<int64_t> decoded(num_rows);
+    packed.CopyEntries(0, num_rows, decoded.data());
+    EXPECT_EQ(decoded, plain.entries);
+    EXPECT_EQ(packed.Entry(12345), plain.entries[12345]);
+    EXPECT_EQ(packed.Entry(76543), plain.entries[76543]);
+
+    IndexList subset;
+    for (int64_t i = 0; i < num_rows; i += 13) {
+        subset.push_back(i);
+    }
+    for (auto comparison_operator: {EQUAL, NOT_EQUAL, LESSER, GREATER, LESSER_OR_EQUAL, GREATER_OR_EQUAL, RANGE_INCLUSIVE, RANGE_EXCLUSIVE}) {
+        IndexList plain_indices, packed_indices;
+        plain.FilterIndices(plain_indices, false, comparison_operator, 2, 1000020);
+        packed.FilterIndices(packed_indices, false, comparison_operator, 2, 1000020);
+        EXPECT_EQ(packed_indices, plain_indices);
+
+        IndexList plain_subset = subset, packed_subset = subset;
+        plain.FilterIndices(plain_subset, true, comparison_operator, 1000030, 1000060);
+        packed.FilterIndices(packed_subset, true, comparison_operator, 1000030, 1000060);
+        EXPECT_EQ(packed_subset, plain_subset);
+    }
+
+    ColumnStatistics plain_stats, packed_stats;
+    ASSERT_TRUE(plain.Aggregate(subset, true, plain_stats));
+    ASSERT_TRUE(packed.Aggregate(subset, true, packed_stats));
+    EXPECT_EQ(packed_stats.count, plain_stats.count);
+    EXPECT_DOUBLE_EQ(packed_stats.sum, plain_stats.sum);
+    EXPECT_EQ(packed_stats.max, plain_stats.max);
+
+    IndexList plain_sorted = subset, packed_sorted = subset;
+    plain.SortIndices(plain_sorted, false);
+    packed.SortIndices(packed_sorted, false);
+    EXPECT_EQ(packed_sorted, plain_sorted);
+}
+
 TEST(Filtering, FailOnWrongFilterType) {
     Table table(test_path("ivoa_example.xml"));
     EXPECT_FALSE(table.View().StringFilter(table["dummy"], "N 224"));
@@ -215,6 +475,8 @@ TEST(Filtering, FailFilterExtractMistypedValues) {
     EXPECT_TRUE(double_vals.empty());
     auto string_vals = view.Values<string>(table["col1"]);
     EXPECT_TRUE(string_vals.empty());
+    auto bool_vals = view.Values<bool>(table["col1"]);
+    EXPECT_TRUE(bool_vals.empty());
 
     view.StringFilter(table["col3"], "N 6744");
     auto float_vals = view.Values<float>(table["col3"]);
@@ -236,6 +498,97 @@ TEST(Filtering, FilterExtractValues) {
     EXPECT_FLOAT_EQ(float_vals[0], 287.43f);
 }
 
+TEST(Filtering, FilterExtractValuesWithoutCopying) {
+    Table table(test_path("ivoa_example.xml"));
+
+    // Full views give direct access to a column's entries
+    auto view = table.View();
+    auto span = view.ValuesSpan<float>(table["RA"], 1);
+    ASSERT_EQ(span.size(), 2);
+    EXPECT_FLOAT_EQ(span[0], 287.43f);
+    EXPECT_FLOAT_EQ(span[1], 23.48f);
+    EXPECT_TRUE(view.ValuesSpan<double>(table["RA"]).empty());
+
+    float buffer[3] = {0, 0, 0};
+    EXPECT_EQ(view.FillValues(table["RA"], buffer, 2, 10), 1);
+    EXPECT_FLOAT_EQ(buffer[0], 23.48f);
+
+    // Subsets are gathered into the buffer
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"]);
+    EXPECT_TRUE(view.ValuesSpan<float>(table["RA"]).empty());
+    EXPECT_EQ(view.FillValues(table["RA"], buffer), 2);
+    EXPECT_FLOAT_EQ(buffer[0], 23.48f);
+    EXPECT_FLOAT_EQ(buffer[1], 287.43f);
+    std::string names[1];
+    EXPECT_EQ(view.FillValues(table["Name"], names, 1), 1);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(view.FillValues(table["Name"], buffer), 0);
+}
+
+TEST(Filtering, FilterExtractConvertedValues) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_EQ(view.ValuesAs<double>(table["RVel"]), std::vector<double>({-297, 839, -182}));
+    EXPECT_TRUE(view.ValuesAs<double>(table["Name"]).empty());
+    EXPECT_TRUE(view.ValuesAs<double>(nullptr).empty());
+
+    // Floating-point entries are rounded towards zero and saturate when converted to integers
+    auto int8_vals = view.ValuesAs<int8_t>(table["RA"]);
+    EXPECT_EQ(int8_vals, std::vector<int8_t>({10, 127, 23}));
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"], false);
+    auto float_vals = view.ValuesAs<float>(table["e_RVel"], 1);
+    EXPECT_EQ(float_vals, std::vector<float>({3}));
+    double buffer[2];
+    EXPECT_EQ(view.FillValuesAs(table["RA"], buffer), 2);
+    EXPECT_NEAR(buffer[0], 287.43, 1e-4);
+    EXPECT_NEAR(buffer[1], 23.48, 1e-4);
+}
+
+TEST(Filtering, FilterExtractBatch) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    RowBatch batch;
+    EXPECT_FALSE(view.FillBatch({table["RA"], nullptr}, 0, 3, batch));
+
+    // Row-major batches hold complete rows, with strings padded to the longest string
+    std::vector<const Column*> columns = {table["RA"], table["RVel"], table["Name"]};
+    EXPECT_TRUE(view.FillBatch(columns, 1, 10, batch));
+    EXPECT_EQ(batch.start, 1);
+    EXPECT_EQ(batch.num_rows, 2);
+    EXPECT_EQ(batch.entry_sizes, std::vector<size_t>({4, 4, 6}));
+    EXPECT_EQ(batch.column_offsets, std::vector<size_t>({0, 4, 8}));
+    ASSERT_EQ(batch.data.size(), 28);
+    float ra;
+    int32_t rvel;
+    memcpy(&ra, batch.data.data() + batch.row_size, sizeof(float));
+    memcpy(&rvel, batch.data.data() + batch.row_size + 4, sizeof(int32_t));
+    EXPECT_FLOAT_EQ(ra, 23.48f);
+    EXPECT_EQ(rvel, -182);
+    EXPECT_EQ(std::string((char*) batch.data.data() + batch.row_size + 8, 6), std::string("N 598\0", 6));
+
+    // Column-major batches hold complete columns
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    view.SortByColumn(table["RA"], false);
+    EXPECT_TRUE(view.FillBatch(columns, 0, 2, batch, COLUMN_MAJOR));
+    EXPECT_EQ(batch.column_offsets, std::vector<size_t>({0, 8, 16}));
+    memcpy(&rvel, batch.data.data() + 8 + 4, sizeof(int32_t));
+    EXPECT_EQ(rvel, -182);
+
+    // Prefetched batches are used only if the rows of the view are unchanged
+    EXPECT_TRUE(view.PrefetchBatch(columns, 0, 1));
+    EXPECT_TRUE(view.FillBatch(columns, 0, 1, batch));
+    EXPECT_EQ(std::string((char*) batch.data.data() + 8, 6), "N 6744");
+    EXPECT_TRUE(view.PrefetchBatch(columns, 0, 1));
+    view.SortByColumn(table["RA"], true);
+    EXPECT_TRUE(view.FillBatch(columns, 0, 1, batch));
+    EXPECT_EQ(std::string((char*) batch.data.data() + 8, 5), "N 598");
+}
+
 TEST(Filtering, NumericFilterEqual) {
     Table table(test_path("ivoa_example.xml"));
     auto view = table.View();
@@ -292,6 +645,614 @@ TEST(Filtering, NumericFilterRange) {
     EXPECT_EQ(view.NumRows(), 0);
 }
 
+TEST(Filtering, BlockStatistics) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto& stats = DataColumn<float>::TryCast(table["RA"])->block_statistics;
+    EXPECT_EQ(stats.size(), 1);
+    EXPECT_FLOAT_EQ(stats[0].min, 10.68f);
+    EXPECT_FLOAT_EQ(stats[0].max, 287.43f);
+    EXPECT_EQ(stats[0].nan_count, 0);
+    EXPECT_TRUE(DataColumn<string>::TryCast(table["Name"])->block_statistics.empty());
+}
+
+TEST(Filtering, MultipleBlockStatistics) {
+    // Blocks whose entries all pass, all fail or are all NaN, followed by a partial block with mixed entries
+    int64_t block_size = STATISTICS_BLOCK_SIZE;
+    int64_t num_rows = 3 * block_size + 1000;
+    DataColumn<double> column("blocks");
+    column.Resize(num_rows);
+    for (int64_t i = 0; i < num_rows; i++) {
+        int64_t block = i / block_size;
+        if (block == 0) {
+            column.entries[i] = i % 10;
+        } else if (block == 1) {
+            column.entries[i] = 100 + i % 10;
+        } else if (block == 2) {
+            column.entries[i] = NAN;
+        } else {
+            column.entries[i] = i % 2 == 0 ? NAN : (i / 2 % 2 ? 15 : 5);
+        }
+    }
+    column.ComputeBlockStatistics();
+
+    auto& stats = column.block_statistics;
+    ASSERT_EQ(stats.size(), 4);
+    EXPECT_EQ(stats[0].min, 0);
+    EXPECT_EQ(stats[0].max, 9);
+    EXPECT_EQ(stats[1].min, 100);
+    EXPECT_EQ(stats[2].nan_count, block_size);
+    EXPECT_EQ(stats[3].nan_count, 500);
+    EXPECT_EQ(stats[3].max, 15);
+
+    // Filters using the statistics must match a scan of every entry, for the full column and for subsets
+    IndexList all_rows(num_rows);
+    std::iota(all_rows.begin(), all_rows.end(), 0);
+    auto scan = [&](ComparisonOperator comparison_operator, double value, double secondary_value) {
+        IndexList expected;
+        for (int64_t i = 0; i < num_rows; i++) {
+            double val = column.entries[i];
+            bool pass = (comparison_operator == RANGE_INCLUSIVE && val >= value && val <= secondary_value)
+                || (comparison_operator == NOT_EQUAL && val != value)
+                || (comparison_operator == GREATER && val > value);
+            if (pass) {
+                expected.push_back(i);
+            }
+        }
+        return expected;
+    };
+    for (auto comparison_operator: {RANGE_INCLUSIVE, NOT_EQUAL, GREATER}) {
+        auto expected = scan(comparison_operator, 0, 9);
+        IndexList indices;
+        column.FilterIndices(indices, false, comparison_operator, 0, 9);
+        EXPECT_EQ(indices, expected);
+        indices = all_rows;
+        column.FilterIndices(indices, true, comparison_operator, 0, 9);
+        EXPECT_EQ(indices, expected);
+    }
+
+    IndexList indices;
+    column.FilterIndices(indices, false, RANGE_INCLUSIVE, 0, 9);
+    EXPECT_EQ(indices.size(), block_size + 250);
+    column.FilterIndices(indices, false, NOT_EQUAL, 1000, 0);
+    EXPECT_EQ(indices.size(), num_rows);
+    column.FilterIndices(indices, false, GREATER, 1000, 0);
+    EXPECT_TRUE(indices.empty());
+}
+
+TEST(Filtering, CombineViews) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto first_view = table.View();
+    first_view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    auto second_view = table.View();
+    second_view.NumericFilter(table["e_RVel"], LESSER_OR_EQUAL, 5);
+
+    auto union_view = first_view;
+    EXPECT_TRUE(union_view.Combine(second_view, UNION));
+    EXPECT_EQ(union_view.NumRows(), 3);
+
+    auto intersection_view = first_view;
+    EXPECT_TRUE(intersection_view.Combine(second_view, INTERSECTION));
+    auto vals = intersection_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+
+    auto symmetric_difference_view = first_view;
+    EXPECT_TRUE(symmetric_difference_view.Combine(second_view, SYMMETRIC_DIFFERENCE));
+    vals = symmetric_difference_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 10.68f);
+    EXPECT_FLOAT_EQ(vals[1], 287.43f);
+
+    auto difference_view = first_view;
+    EXPECT_TRUE(difference_view.Combine(second_view, DIFFERENCE));
+    vals = difference_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+}
+
+TEST(Filtering, CombineUnorderedViews) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto sorted_view = table.View();
+    sorted_view.SortByColumn(table["RA"], false);
+    auto second_view = table.View();
+    second_view.NumericFilter(table["e_RVel"], LESSER_OR_EQUAL, 5);
+
+    // Intersection retains the order of the sorted view
+    EXPECT_TRUE(sorted_view.Combine(second_view, INTERSECTION));
+    auto vals = sorted_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+    EXPECT_FLOAT_EQ(vals[1], 10.68f);
+
+    EXPECT_TRUE(sorted_view.Invert());
+    vals = sorted_view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 1);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+}
+
+TEST(Filtering, SkyRegionFilters) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.ConeFilter(table["RA"], table["Name"], 10, 40, 1));
+    EXPECT_FALSE(view.ConeFilter(table["RA"], table["Dec"], 10, 40, -1));
+    EXPECT_FALSE(view.SkyPolygonFilter(table["RA"], table["Dec"], {0, 10}, {0, 10}));
+
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 10.68, 41.27, 1));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 10.68, 41.27, 15));
+    EXPECT_EQ(view.NumRows(), 2);
+
+    // Cones and boxes may cross RA = 0, and cones may contain a pole
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 359, 41.27, 12));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.ConeFilter(table["RA"], table["Dec"], 0, 90, 50));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+    view.Reset();
+    EXPECT_TRUE(view.SkyBoxFilter(table["RA"], table["Dec"], 280, 20, -90, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 6744"}));
+
+    // Filters compose with the existing rows of the view
+    EXPECT_TRUE(view.SkyBoxFilter(table["RA"], table["Dec"], 0, 360, -70, 35));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 6744"}));
+
+    view.Reset();
+    view.SortByColumn(table["RA"], false);
+    EXPECT_TRUE(view.SkyPolygonFilter(table["RA"], table["Dec"], {355, 30, 30, 355}, {25, 25, 45, 45}));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 598", "N 224"}));
+}
+
+TEST(Filtering, SpatialIndexSearches) {
+    // Enough points for a deep tree, built with parallel tasks, with a few invalid positions that are never indexed
+    int64_t num_rows = 100000;
+    std::mt19937_64 generator(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    vector<double> ra(num_rows), dec(num_rows);
+    vector<array<double, 3>> positions(num_rows);
+    for (int64_t i = 0; i < num_rows; i++) {
+        ra[i] = 360 * uniform(generator);
+        dec[i] = asin(2 * uniform(generator) - 1) * 180 / M_PI;
+        if (i % 1000 == 0) {
+            dec[i] = NAN;
+        }
+        double ra_rad = ra[i] * M_PI / 180;
+        double dec_rad = dec[i] * M_PI / 180;
+        positions[i] = {cos(dec_rad) * cos(ra_rad), cos(dec_rad) * sin(ra_rad), sin(dec_rad)};
+    }
+    SpatialIndex index(ra, dec);
+    EXPECT_EQ(index.NumPoints(), num_rows - 100);
+
+    auto brute_force = [&](auto contains) {
+        IndexList rows;
+        for (int64_t i = 0; i < num_rows; i++) {
+            if (!isnan(dec[i]) && contains(i)) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    };
+    auto unit_vector = [](double ra, double dec) {
+        double ra_rad = ra * M_PI / 180;
+        double dec_rad = dec * M_PI / 180;
+        return array<double, 3>({cos(dec_rad) * cos(ra_rad), cos(dec_rad) * sin(ra_rad), sin(dec_rad)});
+    };
+
+    // Cones crossing RA = 0, containing a pole, and large enough for whole nodes to lie inside
+    IndexList rows;
+    for (auto [cone_ra, cone_dec, radius]: vector<array<double, 3>>({{10, 20, 5}, {359.5, -30, 3}, {0, 90, 7}, {120, 0, 60}})) {
+        auto centre = unit_vector(cone_ra, cone_dec);
+        auto expected = brute_force([&](int64_t i) {
+            double dot = positions[i][0] * centre[0] + positions[i][1] * centre[1] + positions[i][2] * centre[2];
+            return acos(min(dot, 1.0)) * 180 / M_PI <= radius;
+        });
+        EXPECT_TRUE(index.ConeSearch(cone_ra, cone_dec, radius, rows));
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(rows, expected);
+    }
+
+    // Boxes crossing RA = 0, reaching a pole, and wider than 180 degrees in RA
+    for (auto [ra_min, ra_max, dec_min, dec_max]: vector<array<double, 4>>({{20, 60, 30, 50}, {350, 10, -5, 5}, {0, 360, 80, 90}, {100, 300, -20, 20}})) {
+        auto expected = brute_force([&](int64_t i) {
+            bool in_ra = ra_min <= ra_max ? (ra[i] >= ra_min && ra[i] <= ra_max) : (ra[i] >= ra_min || ra[i] <= ra_max);
+            return in_ra && dec[i] >= dec_min && dec[i] <= dec_max;
+        });
+        EXPECT_TRUE(index.BoxSearch(ra_min, ra_max, dec_min, dec_max, rows));
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(rows, expected);
+    }
+
+    // Convex polygons crossing RA = 0 and containing a pole. Points are inside if they lie on the same side of every edge,
+    // in the hemisphere around the polygon's vertices rather than the opposite one
+    vector<pair<vector<double>, vector<double>>> polygons = {{{350, 10, 10, 350}, {-10, -10, 10, 10}}, {{0, 90, 180, 270}, {80, 80, 80, 80}},
+        {{40, 80, 60}, {-20, -20, 10}}};
+    for (auto& [polygon_ra, polygon_dec]: polygons) {
+        size_t num_vertices = polygon_ra.size();
+        vector<array<double, 3>> normals;
+        array<double, 3> centre = {0, 0, 0};
+        for (size_t j = 0; j < num_vertices; j++) {
+            auto a = unit_vector(polygon_ra[j], polygon_dec[j]);
+            for (int axis = 0; axis < 3; axis++) {
+                centre[axis] += a[axis];
+            }
+            auto b = unit_vector(polygon_ra[(j + 1) % num_vertices], polygon_dec[(j + 1) % num_vertices]);
+            normals.push_back({a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]});
+        }
+        auto expected = brute_force([&](int64_t i) {
+            if (positions[i][0] * centre[0] + positions[i][1] * centre[1] + positions[i][2] * centre[2] <= 0) {
+                return false;
+            }
+            size_t num_positive = 0;
+            for (auto& normal: normals) {
+                num_positive += normal[0] * positions[i][0] + normal[1] * positions[i][1] + normal[2] * positions[i][2] > 0;
+            }
+            return num_positive == 0 || num_positive == num_vertices;
+        });
+        EXPECT_TRUE(index.PolygonSearch(polygon_ra, polygon_dec, rows));
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(rows, expected);
+    }
+}
+
+TEST(Filtering, PlanarRegionFilters) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.PolygonFilter(table["RA"], table["Name"], {0, 30, 30}, {25, 25, 45}));
+    EXPECT_FALSE(view.PolygonFilter(table["RA"], table["Dec"], {0, 30}, {25, 25}));
+    EXPECT_FALSE(view.EllipseFilter(table["R"], table["RVel"], 0, 0, 1, 0));
+    EXPECT_EQ(view.NumRows(), 3);
+
+    EXPECT_TRUE(view.PolygonFilter(table["RA"], table["Dec"], {0, 30, 30, 15, 0}, {25, 25, 45, 42, 45}));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 598"}));
+
+    // Filters compose with the existing rows of the view, and can mix column types
+    EXPECT_TRUE(view.EllipseFilter(table["R"], table["RVel"], 0.7, -297, 10, 1, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 224"}));
+
+    view.Reset();
+    view.SortByColumn(table["RVel"], false);
+    EXPECT_TRUE(view.EllipseFilter(table["R"], table["RVel"], 0.7, -240, 60, 1, 90));
+    EXPECT_EQ(view.Values<string>(table["Name"]), std::vector<string>({"N 598", "N 224"}));
+}
+
+TEST(Filtering, CrossMatchTables) {
+    Table table(test_path("ivoa_example.xml"));
+    Table other(test_path("ivoa_example.xml"));
+
+    std::vector<MatchedRows> matches;
+    EXPECT_FALSE(table.CrossMatch(table["RA"], table["Name"], other, other["RA"], other["Dec"], 1, matches));
+    EXPECT_FALSE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], -1, matches));
+
+    // Each row matches itself, and rows 0 and 2 are about 14.8 degrees apart
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 20, matches));
+    ASSERT_EQ(matches.size(), 3);
+    for (int64_t i = 0; i < 3; i++) {
+        EXPECT_EQ(matches[i].row, i);
+        EXPECT_EQ(matches[i].other_row, i);
+        EXPECT_NEAR(matches[i].separation, 0, 1e-6);
+    }
+
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 20, matches, ALL_MATCHES));
+    ASSERT_EQ(matches.size(), 5);
+    std::vector<int64_t> rows, other_rows;
+    for (auto& match: matches) {
+        rows.push_back(match.row);
+        other_rows.push_back(match.other_row);
+    }
+    EXPECT_EQ(rows, std::vector<int64_t>({0, 0, 1, 2, 2}));
+    EXPECT_EQ(other_rows, std::vector<int64_t>({0, 2, 1, 2, 0}));
+    EXPECT_NEAR(matches[1].separation, 14.797, 1e-3);
+
+    EXPECT_TRUE(table.CrossMatch(table["RA"], table["Dec"], other, other["RA"], other["Dec"], 10, matches, ALL_MATCHES));
+    EXPECT_EQ(matches.size(), 3);
+}
+
+TEST(Filtering, CrossMatchLargeTables) {
+    // Random positions in a small patch crossing RA = 0, dense enough for many matches within the radius
+    std::mt19937_64 generator(7);
+    std::uniform_real_distribution<double> uniform(-5, 5);
+    auto random_positions = [&](int64_t num_rows, vector<double>& ra, vector<double>& dec) {
+        ra.resize(num_rows);
+        dec.resize(num_rows);
+        for (int64_t i = 0; i < num_rows; i++) {
+            ra[i] = fmod(uniform(generator) + 360, 360);
+            dec[i] = uniform(generator);
+        }
+    };
+    vector<double> ra, dec, other_ra, other_dec;
+    random_positions(2000, ra, dec);
+    random_positions(5000, other_ra, other_dec);
+    auto table_path = write_synthetic_table("cross_match_table.xml", {{"RA", ra}, {"Dec", dec}});
+    auto other_path = write_synthetic_table("cross_match_other.xml", {{"RA", other_ra}, {"Dec", other_dec}});
+    Table table(table_path);
+    Table other(other_path);
+    ASSERT_TRUE(table.IsValid());
+    ASSERT_TRUE(other.IsValid());
+
+    auto separation = [](double ra_a, double dec_a, double ra_b, double dec_b) {
+        double sin_dec = sin((dec_b - dec_a) * M_PI / 360);
+        double sin_ra = sin((ra_b - ra_a) * M_PI / 360);
+        double haversine = sin_dec * sin_dec + cos(dec_a * M_PI / 180) * cos(dec_b * M_PI / 180) * sin_ra * sin_ra;
+        return 360 / M_PI * asin(sqrt(haversine));
+    };
+
+    // Matches are ordered by row, then by separation, with the nearest match of each row kept for best matches
+    double radius = 0.2;
+    auto brute_force = [&](const vector<double>& ra, const vector<double>& dec, const vector<double>& other_ra,
+        const vector<double>& other_dec, CrossMatchMode mode) {
+        vector<MatchedRows> matches;
+        for (int64_t i = 0; i < ra.size(); i++) {
+            vector<MatchedRows> row_matches;
+            for (int64_t j = 0; j < other_ra.size(); j++) {
+                double row_separation = separation(ra[i], dec[i], other_ra[j], other_dec[j]);
+                if (row_separation <= radius) {
+                    row_matches.push_back({i, j, row_separation});
+                }
+            }
+            sort(row_matches.begin(), row_matches.end(), [](const MatchedRows& a, const MatchedRows& b) {
+                return a.separation < b.separation;
+            });
+            if (mode == BEST_MATCH && row_matches.size() > 1) {
+                row_matches.resize(1);
+            }
+            matches.insert(matches.end(), row_matches.begin(), row_matches.end());
+        }
+        return matches;
+    };
+
+    // Either table may be the larger one, which changes the table that is indexed for all matches
+    std::vector<MatchedRows> matches;
+    for (auto mode: {BEST_MATCH, ALL_MATCHES}) {
+        for (auto smaller_first: {true, false}) {
+            auto& first = smaller_first ? table : other;
+            auto& second = smaller_first ? other : table;
+            auto expected = smaller_first ? brute_force(ra, dec, other_ra, other_dec, mode) : brute_force(other_ra, other_dec, ra, dec, mode);
+            EXPECT_TRUE(first.CrossMatch(first["RA"], first["Dec"], second, second["RA"], second["Dec"], radius, matches, mode));
+            EXPECT_GT(expected.size(), 1000);
+            ASSERT_EQ(matches.size(), expected.size());
+            for (size_t i = 0; i < matches.size(); i++) {
+                EXPECT_EQ(matches[i].row, expected[i].row);
+                EXPECT_EQ(matches[i].other_row, expected[i].other_row);
+                EXPECT_NEAR(matches[i].separation, expected[i].separation, 1e-9);
+            }
+        }
+    }
+    filesystem::remove(table_path);
+    filesystem::remove(other_path);
+}
+
+TEST(Filtering, JoinTables) {
+    Table table(test_path("ivoa_example.xml"));
+    Table other(test_path("ivoa_example.xml"));
+
+    EXPECT_FALSE(table.View().Join(table["R"], other.View(), other["R"]).IsValid());
+    EXPECT_FALSE(table.View().Join(table["Name"], other.View(), other["RVel"]).IsValid());
+    auto mixed_widths = table.View().Join(table["e_RVel"], other.View(), other["RVel"]);
+    EXPECT_TRUE(mixed_widths.IsValid());
+    EXPECT_EQ(mixed_widths.NumRows(), 0);
+
+    // Joined rows follow the order of the left view
+    auto left_view = table.View();
+    left_view.NumericFilter(table["RVel"], LESSER, 0);
+    auto right_view = other.View();
+    right_view.SortByColumn(other["RA"], false);
+    auto joined = left_view.Join(table["Name"], right_view, other["Name"]);
+    EXPECT_TRUE(joined.IsValid());
+    EXPECT_EQ(joined.LeftRows(), IndexList({0, 2}));
+    EXPECT_EQ(joined.RightRows(), IndexList({0, 2}));
+    EXPECT_EQ(joined.Values<int32_t>(other["RVel"]), std::vector<int32_t>({-297, -182}));
+
+    // Unmatched rows of a left join use missing entries from the right table
+    right_view.Reset();
+    right_view.NumericFilter(other["RVel"], GREATER, 0);
+    auto left_joined = table.View().Join(table["Name"], right_view, other["Name"], LEFT_JOIN);
+    EXPECT_EQ(left_joined.NumRows(), 3);
+    EXPECT_EQ(left_joined.RightRows(), IndexList({-1, 1, -1}));
+    EXPECT_EQ(left_joined.Values<string>(table["Name"]), std::vector<string>({"N 224", "N 6744", "N 598"}));
+    EXPECT_EQ(left_joined.Values<string>(other["Name"]), std::vector<string>({"", "N 6744", ""}));
+    std::vector<double> velocities(3);
+    EXPECT_EQ(left_joined.FillValuesAs(other["RVel"], velocities.data()), 3);
+    EXPECT_TRUE(std::isnan(velocities[0]) && std::isnan(velocities[2]));
+    EXPECT_EQ(velocities[1], 839);
+    EXPECT_EQ(left_joined.FillValuesAs(other["RVel"], velocities.data(), 0, -1, -1.0), 3);
+    EXPECT_EQ(velocities, std::vector<double>({-1, 839, -1}));
+}
+
+TEST(Aggregation, ColumnStatistics) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    ColumnStatistics stats;
+    EXPECT_FALSE(view.Aggregate(nullptr, stats));
+    EXPECT_FALSE(view.Aggregate(table["Name"], stats));
+
+    EXPECT_TRUE(view.Aggregate(table["e_RVel"], stats));
+    EXPECT_EQ(stats.count, 3);
+    EXPECT_EQ(stats.nan_count, 0);
+    EXPECT_DOUBLE_EQ(stats.sum, 14);
+    EXPECT_DOUBLE_EQ(stats.mean, 14.0 / 3.0);
+    EXPECT_DOUBLE_EQ(stats.min, 3);
+    EXPECT_DOUBLE_EQ(stats.max, 6);
+    EXPECT_DOUBLE_EQ(stats.variance, 14.0 / 9.0);
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Aggregate(table["RA"], stats));
+    EXPECT_EQ(stats.count, 2);
+    EXPECT_NEAR(stats.mean, (287.43 + 23.48) / 2, 1e-4);
+    EXPECT_FLOAT_EQ(stats.min, 23.48f);
+    EXPECT_FLOAT_EQ(stats.max, 287.43f);
+}
+
+TEST(Aggregation, Histogram) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    ColumnHistogram histogram;
+    EXPECT_FALSE(view.Histogram(nullptr, 3, histogram));
+    EXPECT_FALSE(view.Histogram(table["Name"], 3, histogram));
+    EXPECT_FALSE(view.Histogram(table["e_RVel"], 0, histogram));
+
+    // Automatic range, with the maximum included in the last bin
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_DOUBLE_EQ(histogram.min, 3);
+    EXPECT_DOUBLE_EQ(histogram.max, 6);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 2}));
+
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 2, histogram, false, 0, 10));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 2}));
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 2, histogram, false, 4, NAN));
+    EXPECT_DOUBLE_EQ(histogram.min, 4);
+    EXPECT_DOUBLE_EQ(histogram.max, 6);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({0, 2}));
+
+    // Log-scale ranges exclude non-positive entries
+    EXPECT_TRUE(view.Histogram(table["R"], 2, histogram, true));
+    EXPECT_TRUE(histogram.log_scale);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({2, 1}));
+    EXPECT_TRUE(view.Histogram(table["RVel"], 2, histogram, true));
+    EXPECT_DOUBLE_EQ(histogram.min, 839);
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0}));
+    EXPECT_FALSE(view.Histogram(table["RVel"], 2, histogram, true, 0, 1000));
+
+    // Cached histograms are discarded when the view changes
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 1}));
+    view.Reset();
+    EXPECT_TRUE(view.Histogram(table["e_RVel"], 3, histogram));
+    EXPECT_EQ(histogram.counts, std::vector<int64_t>({1, 0, 2}));
+}
+
+TEST(Aggregation, GroupBy) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.GroupBy(nullptr).IsValid());
+
+    // Floating-point keys are hashed
+    auto groups = view.GroupBy(table["R"]);
+    EXPECT_TRUE(groups.IsValid());
+    EXPECT_EQ(groups.NumGroups(), 2);
+    auto float_keys = groups.Keys<float>();
+    ASSERT_EQ(float_keys.size(), 2);
+    EXPECT_FLOAT_EQ(float_keys[0], 0.7f);
+    EXPECT_FLOAT_EQ(float_keys[1], 10.4f);
+    EXPECT_EQ(groups.GroupSizes(), IndexList({2, 1}));
+    EXPECT_TRUE(groups.Keys<double>().empty());
+
+    std::vector<ColumnStatistics> stats;
+    EXPECT_FALSE(groups.Aggregate(table["Name"], stats));
+    EXPECT_TRUE(groups.Aggregate(table["e_RVel"], stats));
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_EQ(stats[0].count, 2);
+    EXPECT_DOUBLE_EQ(stats[0].mean, 4);
+    EXPECT_DOUBLE_EQ(stats[0].variance, 1);
+    EXPECT_EQ(stats[1].count, 1);
+    EXPECT_DOUBLE_EQ(stats[1].mean, 6);
+
+    // Small-range integer keys are indexed directly
+    auto int_groups = view.GroupBy(table["e_RVel"]);
+    EXPECT_EQ(int_groups.Keys<int16_t>(), std::vector<int16_t>({3, 5, 6}));
+    EXPECT_EQ(int_groups.GroupSizes(), IndexList({1, 1, 1}));
+
+    auto string_groups = view.GroupBy(table["Name"]);
+    EXPECT_EQ(string_groups.Keys<std::string>(), std::vector<std::string>({"N 224", "N 598", "N 6744"}));
+
+    // Only the rows of a filtered view are grouped
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    auto filtered_groups = view.GroupBy(table["R"]);
+    EXPECT_EQ(filtered_groups.GroupSizes(), IndexList({1, 1}));
+    EXPECT_TRUE(filtered_groups.Aggregate(table["RVel"], stats));
+    ASSERT_EQ(stats.size(), 2);
+    EXPECT_DOUBLE_EQ(stats[0].sum, -182);
+    EXPECT_DOUBLE_EQ(stats[1].sum, 839);
+}
+
+TEST(Aggregation, Quantiles) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    std::vector<double> quantiles;
+    EXPECT_FALSE(view.Quantiles(nullptr, {0.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["Name"], {0.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["RA"], {1.5}, quantiles));
+    EXPECT_FALSE(view.Quantiles(table["RA"], {-0.1}, quantiles, true));
+
+    EXPECT_TRUE(view.Quantiles(table["e_RVel"], {0.75, 0.5}, quantiles, true));
+    EXPECT_EQ(quantiles, std::vector<double>({5.5, 5}));
+    // Exact quantiles of the full table use the sorted index if it has been cached
+    ASSERT_TRUE(table.SortedIndices(table["e_RVel"]));
+    EXPECT_TRUE(view.Quantiles(table["e_RVel"], {0.75, 0.5}, quantiles, true));
+    EXPECT_EQ(quantiles, std::vector<double>({5.5, 5}));
+
+    // The sketch keeps small columns exactly
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0, 0.5, 1}, quantiles));
+    ASSERT_EQ(quantiles.size(), 3);
+    EXPECT_FLOAT_EQ(quantiles[0], 10.68f);
+    EXPECT_FLOAT_EQ(quantiles[1], 23.48f);
+    EXPECT_FLOAT_EQ(quantiles[2], 287.43f);
+
+    EXPECT_TRUE(view.ClipByQuantiles(table["RA"], 0, 0.5, true));
+    EXPECT_EQ(view.NumRows(), 2);
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0.5}, quantiles));
+    EXPECT_NEAR(quantiles[0], (10.68 + 23.48) / 2, 1e-4);
+    EXPECT_TRUE(view.Quantiles(table["RA"], {0.5}, quantiles, true));
+    EXPECT_NEAR(quantiles[0], (10.68 + 23.48) / 2, 1e-4);
+}
+
+TEST(Aggregation, Density) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    DensityGrid grid;
+    EXPECT_FALSE(view.Density(table["RA"], table["Name"], 2, 2, grid));
+    EXPECT_FALSE(view.Density(table["RA"], table["Dec"], 0, 2, grid));
+
+    // Coarse grids over the full range are re-binned from the pyramid
+    EXPECT_TRUE(view.Density(table["RA"], table["Dec"], 2, 2, grid));
+    EXPECT_FLOAT_EQ(grid.x_min, 10.68f);
+    EXPECT_FLOAT_EQ(grid.y_max, 41.27f);
+    EXPECT_EQ(grid.counts, std::vector<int64_t>({0, 1, 2, 0}));
+    EXPECT_EQ(grid.rows, IndexList({-1, 1, 0, -1}));
+
+    // Fine grids are binned directly
+    EXPECT_TRUE(view.Density(table["RA"], table["RVel"], 400, 1, grid, 0, 40));
+    EXPECT_EQ(std::accumulate(grid.counts.begin(), grid.counts.end(), int64_t(0)), 2);
+    EXPECT_EQ(grid.counts[106], 1);
+    EXPECT_EQ(grid.rows[234], 2);
+
+    view.NumericFilter(table["RA"], GREATER_OR_EQUAL, 11);
+    EXPECT_TRUE(view.Density(table["RA"], table["Dec"], 1, 2, grid));
+    EXPECT_FLOAT_EQ(grid.x_min, 23.48f);
+    EXPECT_EQ(grid.counts, std::vector<int64_t>({1, 1}));
+    EXPECT_EQ(grid.rows, IndexList({1, 2}));
+}
+
+TEST(Aggregation, LargeColumnQuantiles) {
+    // Approximate quantiles of a large column are within a small fraction of the range of the exact quantiles
+    DataColumn<double> column("large");
+    column.Resize(100000);
+    for (auto i = 0; i < 100000; i++) {
+        column.entries[i] = (i % 11 == 0) ? NAN : (i * 7919) % 100000;
+    }
+
+    std::vector<double> fractions = {0.001, 0.01, 0.25, 0.5, 0.99};
+    std::vector<double> exact_quantiles;
+    EXPECT_TRUE(column.ExactQuantiles(IndexList(), false, false, fractions, exact_quantiles));
+    QuantileSketch sketch;
+    EXPECT_TRUE(column.FillQuantileSketch(IndexList(), false, sketch));
+    EXPECT_EQ(sketch.Count(), 100000 - 9091);
+    for (auto i = 0; i < fractions.size(); i++) {
+        EXPECT_NEAR(sketch.Quantile(fractions[i]), exact_quantiles[i], 50);
+    }
+}
+
 TEST(Sorting, FailSortMissingColummn) {
     Table table(test_path("ivoa_example.xml"));
 
@@ -367,6 +1328,228 @@ TEST(Sorting, SortStringSubset) {
     EXPECT_EQ(vals[1], "N 6744");
 }
 
+TEST(Sorting, TopRows) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.TopByColumn(nullptr, 2));
+    EXPECT_TRUE(view.TopByColumn(table["RA"], 2, false));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+}
+
+TEST(Sorting, TopRowsTies) {
+    Table table(test_path("ivoa_example.xml"));
+
+    // Tied rows keep their table order whether or not the column has a cached sorted index
+    for (auto cached: {false, true}) {
+        if (cached) {
+            ASSERT_NE(table.SortedIndices(table["R"]), nullptr);
+        }
+        auto view = table.View();
+        EXPECT_TRUE(view.TopByColumn(table["R"], 3, false));
+        auto names = view.Values<string>(table["Name"]);
+        ASSERT_EQ(names.size(), 3);
+        EXPECT_EQ(names[0], "N 6744");
+        EXPECT_EQ(names[1], "N 224");
+        EXPECT_EQ(names[2], "N 598");
+    }
+}
+
+TEST(Sorting, PartialSort) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_TRUE(view.PartialSortByColumn(table["RA"], 1, 2));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_EQ(vals.size(), 3);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+
+    // A negative end sorts to the last row
+    view.Reset();
+    EXPECT_TRUE(view.PartialSortByColumn(table["RA"], 1, -1, false));
+    vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+    EXPECT_FLOAT_EQ(vals[2], 10.68f);
+}
+
+TEST(Sorting, SortMultipleColumns) {
+    Table table(test_path("ivoa_example.xml"));
+
+    auto view = table.View();
+    EXPECT_FALSE(view.SortByColumns({}));
+    EXPECT_FALSE(view.SortByColumns({{table["R"], true}, {nullptr, true}}));
+    EXPECT_TRUE(view.SortByColumns({{table["R"], true}, {table["RA"], false}}));
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[0], 23.48f);
+    EXPECT_FLOAT_EQ(vals[1], 10.68f);
+    EXPECT_FLOAT_EQ(vals[2], 287.43f);
+
+    EXPECT_TRUE(view.SortByColumns({{table["R"], false}, {table["Name"], true}}));
+    auto names = view.Values<string>(table["Name"]);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(names[1], "N 224");
+    EXPECT_EQ(names[2], "N 598");
+
+    // A single descending column keeps rows with equal values in their existing order
+    view.Reset();
+    EXPECT_TRUE(view.SortByColumns({{table["R"], false}}));
+    names = view.Values<string>(table["Name"]);
+    EXPECT_EQ(names[0], "N 6744");
+    EXPECT_EQ(names[1], "N 224");
+    EXPECT_EQ(names[2], "N 598");
+}
+
+TEST(Sorting, CachedSortedIndex) {
+    Table table(test_path("ivoa_example.xml"));
+
+    EXPECT_EQ(table.SortedIndices(nullptr), nullptr);
+    EXPECT_EQ(table.SortedIndices(table["RA"], false), nullptr);
+    auto sorted_indices = table.SortedIndices(table["RA"]);
+    ASSERT_NE(sorted_indices, nullptr);
+    EXPECT_EQ(*sorted_indices, IndexList({0, 2, 1}));
+    EXPECT_EQ(table.SortedIndices(table["RA"], false), sorted_indices);
+
+    // Filters on a column with a cached index must give the same results as a scan
+    auto view = table.View();
+    view.NumericFilter(table["RA"], RANGE_INCLUSIVE, 11, 300);
+    EXPECT_EQ(view.NumRows(), 2);
+    auto vals = view.Values<float>(table["RA"]);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+}
+
+TEST(Sorting, CachedSortedIndexFilter) {
+    // Few enough rows match for the filter to read them from the cached sorted index rather than scanning
+    int64_t num_rows = 5000;
+    vector<double> x(num_rows), y(num_rows), rows(num_rows);
+    for (int64_t i = 0; i < num_rows; i++) {
+        x[i] = (i * 7919) % 1000;
+        y[i] = (i * 104729) % num_rows;
+        rows[i] = i;
+    }
+    auto table_path = write_synthetic_table("sorted_index_filter.xml", {{"x", x}, {"y", y}, {"row", rows}});
+    Table table(table_path);
+    ASSERT_TRUE(table.IsValid());
+
+    // Full views, ordered subsets and unordered subsets are filtered
+    auto filtered_rows = [&]() {
+        vector<vector<double>> results;
+        auto full_view = table.View();
+        auto ordered_view = table.View();
+        ordered_view.NumericFilter(table["y"], LESSER, 2500);
+        auto unordered_view = table.View();
+        unordered_view.SortByColumn(table["y"], false);
+        for (auto view: {full_view, ordered_view, unordered_view}) {
+            view.NumericFilter(table["x"], RANGE_INCLUSIVE, 100, 104);
+            results.push_back(view.Values<double>(table["row"]));
+        }
+        return results;
+    };
+
+    ASSERT_EQ(table.SortedIndices(table["x"], false), nullptr);
+    auto scanned = filtered_rows();
+    EXPECT_EQ(scanned[0].size(), 25);
+    ASSERT_NE(table.SortedIndices(table["x"]), nullptr);
+    auto indexed = filtered_rows();
+    EXPECT_EQ(indexed, scanned);
+
+    // The unordered subset keeps its descending order of y
+    for (size_t i = 1; i < indexed[2].size(); i++) {
+        EXPECT_GT(y[indexed[2][i - 1]], y[indexed[2][i]]);
+    }
+    filesystem::remove(table_path);
+}
+
+TEST(Sorting, SortLargeNumericColumn) {
+    // Columns with many entries are sorted with a radix sort rather than a comparison sort
+    DataColumn<double> column("large");
+    column.Resize(5000);
+    for (auto i = 0; i < 5000; i++) {
+        column.entries[i] = (i % 7 == 0) ? NAN : ((i * 7919) % 5000) - 2500.5;
+    }
+
+    for (auto ascending: {true, false}) {
+        IndexList indices(5000);
+        iota(indices.begin(), indices.end(), 0);
+        column.SortIndices(indices, ascending);
+        auto num_valid = column.NumValidSorted(indices);
+        EXPECT_EQ(num_valid, 5000 - 715);
+        for (auto i = 1; i < num_valid; i++) {
+            auto previous = column.entries[indices[i - 1]];
+            auto current = column.entries[indices[i]];
+            EXPECT_TRUE(ascending ? previous <= current : previous >= current);
+        }
+        for (auto i = num_valid; i < 5000; i++) {
+            EXPECT_TRUE(isnan(column.entries[indices[i]]));
+        }
+    }
+}
+
+TEST(Sorting, SortLargeStringColumn) {
+    // Strings share long prefixes, so must be sorted by several successive prefix keys
+    DataColumn<string> column("large");
+    column.Resize(5000);
+    for (auto i = 0; i < 5000; i++) {
+        column.entries[i] = fmt::format("NAME COSMOS {}", (i * 7919) % 5000);
+    }
+
+    for (auto ascending: {true, false}) {
+        IndexList indices(5000);
+        iota(indices.begin(), indices.end(), 0);
+        column.SortIndices(indices, ascending);
+        for (auto i = 1; i < 5000; i++) {
+            auto& previous = column.entries[indices[i - 1]];
+            auto& current = column.entries[indices[i]];
+            EXPECT_TRUE(ascending ? previous < current : previous > current);
+        }
+    }
+}
+
+TEST(Sorting, SortLongStringPrefixes) {
+    // Names share prefixes longer than their normalized keys, or differ only in length. Equal names are ordered by group
+    std::vector<string> names = {"NAME COSMOS J100012+020304", "NAME COSMOS J100012+020303", "NAME COSMOS J1000", "NAME COSMOS J100012",
+        "NAME COSMOS J100", "NAME COSMOS J100012+020304", "NAME COS", "NAME COSMOS J100012+0203"};
+    std::vector<int32_t> groups = {1, 0, 0, 1, 0, 0, 1, 1};
+    auto path = (filesystem::temp_directory_path() / "long_prefixes.xml").string();
+    {
+        std::ofstream file(path);
+        file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<VOTABLE version=\"1.4\">\n<RESOURCE>\n<TABLE>\n"
+             << "<FIELD name=\"Name\" datatype=\"char\" arraysize=\"*\"/>\n<FIELD name=\"Group\" datatype=\"int\"/>\n"
+             << "<DATA>\n<TABLEDATA>\n";
+        for (auto i = 0; i < names.size(); i++) {
+            file << fmt::format("<TR><TD>{}</TD><TD>{}</TD></TR>\n", names[i], groups[i]);
+        }
+        file << "</TABLEDATA>\n</DATA>\n</TABLE>\n</RESOURCE>\n</VOTABLE>\n";
+    }
+
+    Table table(path);
+    ASSERT_TRUE(table.IsValid());
+    for (auto ascending: {true, false}) {
+        IndexList expected(names.size());
+        iota(expected.begin(), expected.end(), 0);
+        std::stable_sort(expected.begin(), expected.end(), [&](int64_t a, int64_t b) {
+            if (names[a] != names[b]) {
+                return ascending ? names[a] < names[b] : names[a] > names[b];
+            }
+            return groups[a] < groups[b];
+        });
+
+        auto view = table.View();
+        EXPECT_TRUE(view.SortByColumns({{table["Name"], ascending}, {table["Group"], true}}));
+        auto sorted_names = view.Values<string>(table["Name"]);
+        auto sorted_groups = view.Values<int32_t>(table["Group"]);
+        ASSERT_EQ(sorted_names.size(), names.size());
+        for (auto i = 0; i < names.size(); i++) {
+            EXPECT_EQ(sorted_names[i], names[expected[i]]);
+            EXPECT_EQ(sorted_groups[i], groups[expected[i]]);
+        }
+    }
+    filesystem::remove(path);
+}
+
 TEST(Arrays, ParseArrayFile) {
     Table table(test_path("array_types.xml"));
     EXPECT_TRUE(table.IsValid());